@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Minimal harness for the headless benchmarks; every case reports the average time per operation, and how many heap allocations it did.
+// Every reported case is also kept in `results`, so that main.cpp can write them out as JSON.
+// The cases also check their results; a failed check (see `fail`) makes the benchmark exit with 1.
+
+// bumped by the global `operator new` of the benchmark executable (see main.cpp)
+inline std::atomic<std::size_t> heap_allocations{0};
+
+struct bench_result final
+{
+    char const *name;
+    std::size_t n;
+    double ns_per_op;
+    std::size_t allocations;
+};
+
+// Time `fn` once and divide by the number of operations it did
+template <typename Func>
+inline bench_result measure(char const *name, std::size_t n, Func &&fn)
+{
+    auto const allocs = heap_allocations.load(std::memory_order_relaxed);
+    auto const start = std::chrono::steady_clock::now();
+    fn();
+    auto const finish = std::chrono::steady_clock::now();
+
+    auto const ns = std::chrono::duration<double, std::nano>(finish - start).count();
+    return {name, n, ns / double(n), heap_allocations.load(std::memory_order_relaxed) - allocs};
+}
+
+inline std::vector<bench_result> results;
+
+inline std::size_t failed_checks = 0;
+
+// Report a case that didn't do what it should have, `printf` style
+inline void fail(char const *fmt, ...)
+{
+    std::printf("ERROR: ");
+
+    std::va_list args;
+    va_start(args, fmt);
+    std::vprintf(fmt, args);
+    va_end(args);
+
+    ++failed_checks;
+}
+
+inline void report(bench_result const &r)
+{
+    std::printf("%-40s n=%-10zu %12.2f ns/op %10zu allocs\n", r.name, r.n, r.ns_per_op, r.allocations);
+    results.push_back(r);
+}
+
+// One object per case: `{"name", "n", "ns_per_op", "allocs_per_op"}`
+// NOTE: the names are string literals without anything to escape
+inline void write_json(std::FILE *out)
+{
+    std::fprintf(out, "[\n");
+    for (std::size_t i{}; i < results.size(); ++i)
+    {
+        auto &&r = results[i];
+        std::fprintf(out, "  {\"name\": \"%s\", \"n\": %zu, \"ns_per_op\": %.3f, \"allocs_per_op\": %.6f}%s\n",
+                     r.name, r.n, r.ns_per_op, double(r.allocations) / double(r.n),
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "]\n");
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <vector>
+
+#include "coro/channel.hpp"
+#include "coro/stage.hpp"
+#include "bench.hpp"
+
+// One producer sends `n` values through a `channel` with room for 64 to one consumer, which takes them one by one or in batches.
+// Both suspend whenever the channel is full or empty, and are resumed through their stage until every value went through.
+
+namespace channels_bench
+{
+    inline constexpr std::size_t capacity = 64;
+
+    inline auto produce(channel<std::size_t> &ch, std::size_t n) -> fire_and_forget
+    {
+        for (std::size_t i{}; i < n; ++i)
+            co_await ch.send(i);
+
+        ch.close();
+    }
+
+    inline auto consume(channel<std::size_t> &ch, std::size_t &sum, bool &done) -> fire_and_forget
+    {
+        while (auto val = co_await ch.recv())
+            sum += *val;
+
+        done = true;
+    }
+
+    inline auto consume_many(channel<std::size_t> &ch, std::size_t &sum, bool &done) -> fire_and_forget
+    {
+        std::array<std::size_t, capacity> batch;
+        while (auto const n = co_await ch.recv_many(batch))
+        {
+            for (auto val : std::span{batch}.first(n))
+                sum += val;
+        }
+
+        done = true;
+    }
+
+    inline void run(std::size_t n)
+    {
+        std::vector<trace> traces;
+
+        // until the consumer saw the channel close
+        auto pump = [&](stage_info &s, bool const &done)
+        {
+            while (!done)
+            {
+                traces.clear();
+                s.run_into(SDL_GetTicksNS(), traces);
+            }
+        };
+
+        auto check = [n](char const *name, std::size_t sum)
+        {
+            if (sum != n * (n - 1) / 2)
+                fail("%s: expected a sum of %zu, got %zu\n", name, n * (n - 1) / 2, sum);
+        };
+
+        {
+            stage_info s;
+            channel<std::size_t> ch{s, capacity};
+            std::size_t sum = 0;
+            bool done = false;
+
+            report(measure("channel/send+recv", n, [&]
+                           {
+                               consume(ch, sum, done);
+                               produce(ch, n);
+                               pump(s, done);
+                           }));
+            check("channel/send+recv", sum);
+        }
+
+        {
+            stage_info s;
+            channel<std::size_t> ch{s, capacity};
+            std::size_t sum = 0;
+            bool done = false;
+
+            report(measure("channel/send+recv_many", n, [&]
+                           {
+                               consume_many(ch, sum, done);
+                               produce(ch, n);
+                               pump(s, done);
+                           }));
+            check("channel/send+recv_many", sum);
+        }
+    }
+}
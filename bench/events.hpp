@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+
+#include "coro/events/event.hpp"
+#include "coro/events/exclusive.hpp"
+#include "coro/events/permanent.hpp"
+#include "coro/stage.hpp"
+#include "bench.hpp"
+
+// Trigger fan-out of the event types: `n` coroutines wait on the same event, which wakes all of them at once.
+// `exclusive_event` only has room for one waiter, so there a single coroutine waits and gets woken `n` times instead.
+// Every case includes resuming the woken coroutines through their stage.
+
+namespace events_bench
+{
+    inline auto wait_once(event<int> &e, std::size_t &sum) -> fire_and_forget
+    {
+        sum += co_await e;
+    }
+
+    inline auto wait_once(permanent_event &e, std::size_t &sum) -> fire_and_forget
+    {
+        co_await e;
+        ++sum;
+    }
+
+    inline auto wait_many(exclusive_event<int> &e, std::size_t n, std::size_t &sum) -> fire_and_forget
+    {
+        for (std::size_t i{}; i < n; ++i)
+            sum += co_await e;
+    }
+
+    inline void run(std::size_t n)
+    {
+        std::vector<trace> traces;
+        std::size_t sum = 0;
+
+        {
+            stage_info s;
+            event<int> e{s};
+            for (std::size_t i{}; i < n; ++i)
+                wait_once(e, sum);
+
+            report(measure("event/trigger+resume", n, [&]
+                           {
+                               e.trigger(1);
+                               s.run_into(SDL_GetTicksNS(), traces);
+                           }));
+        }
+
+        {
+            stage_info s;
+            permanent_event e{s};
+            for (std::size_t i{}; i < n; ++i)
+                wait_once(e, sum);
+
+            report(measure("permanent_event/trigger+resume", n, [&]
+                           {
+                               e.trigger();
+                               s.run_into(SDL_GetTicksNS(), traces);
+                           }));
+        }
+
+        {
+            stage_info s;
+            exclusive_event<int> e{s};
+            wait_many(e, n, sum);
+
+            traces.clear();
+            report(measure("exclusive_event/trigger+resume", n, [&]
+                           {
+                               for (std::size_t i{}; i < n; ++i)
+                               {
+                                   traces.clear();
+                                   e.trigger(1);
+                                   s.run_into(SDL_GetTicksNS(), traces);
+                               }
+                           }));
+        }
+
+        if (sum != 3 * n)
+            fail("events: expected %zu wake ups, got %zu\n", 3 * n, sum);
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <coroutine>
+#include <mutex>
+#include <queue>
+#include <source_location>
+#include <vector>
+
+#include <SDL3/SDL_timer.h>
+
+#include "coro/profiler.hpp"
+#include "utils/spin_lock.hpp"
+
+// Frozen copy of the ready queue of `stage_info` from before it went intrusive, kept only to compare against.
+// Every scheduled coroutine is copied into a `std::queue` (a deque, which allocates as it grows), and every awaiter returns `std::noop_coroutine()` to the run loop.
+// NOTE: traces are named the way `stage_info` does it now (see `suspend_sites`), so that only the queues differ
+namespace legacy
+{
+    struct coro_state final
+    {
+        std::coroutine_handle<> hnd;
+        std::source_location suspend_point;
+        Uint64 wait_start = 0;
+    };
+
+    struct stage final
+    {
+        inline void schedule(coro_state t)
+        {
+            t.wait_start = SDL_GetTicksNS();
+
+            std::scoped_lock lk{lock};
+            ready_queue.push(t);
+        }
+
+        inline void run_into(std::vector<trace> &out)
+        {
+            auto const n_ready = ready_queue.size();
+            out.reserve(out.size() + n_ready);
+
+            auto start = SDL_GetTicksNS();
+            for (std::size_t i{}; i < n_ready; ++i)
+            {
+                coro_state t;
+                {
+                    std::scoped_lock lk{lock};
+                    t = ready_queue.front();
+                    ready_queue.pop();
+                }
+
+                t.hnd.resume();
+
+                auto const finish = SDL_GetTicksNS();
+                out.push_back({
+                    .site = suspend_sites::global().intern(t.suspend_point),
+                    .tid = std::this_thread::get_id(),
+                    .wait_start = t.wait_start,
+                    .wait_finish = t.wait_start,
+                    .start = start,
+                    .finish = finish,
+                });
+                start = finish;
+            }
+        }
+
+        struct sched_awaiter final
+        {
+            stage *s;
+
+            static constexpr bool await_ready() noexcept { return false; }
+
+            inline auto await_suspend(std::coroutine_handle<> hnd,
+                                      std::source_location const &sl = std::source_location::current()) noexcept
+            {
+                s->schedule({hnd, sl});
+                return std::noop_coroutine();
+            }
+
+            static constexpr void await_resume() noexcept {}
+        };
+        inline sched_awaiter sched() noexcept { return {this}; }
+
+    private:
+        spin_lock lock;
+        std::queue<coro_state> ready_queue;
+    };
+}
@@ -0,0 +1,105 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "channels.hpp"
+#include "events.hpp"
+#include "stages.hpp"
+#include "tasks.hpp"
+#include "timers.hpp"
+
+// Headless benchmarks for the coroutine runtime; no window or renderer is created.
+// Usage: coro_bench [--json <path>]
+// With `--json`, the results are also written to `path` (see `write_json`), eg. to compare them across versions.
+// Exits with 1 if a case didn't do what it should have (see `fail`), even though its timings are still reported.
+
+// count every heap allocation, see `heap_allocations`
+// NOTE: every form of `new` and `delete` is replaced, so that they all come from and go back to `malloc`
+namespace
+{
+    void *counted_alloc(std::size_t n, std::align_val_t align = std::align_val_t{alignof(std::max_align_t)})
+    {
+        heap_allocations.fetch_add(1, std::memory_order_relaxed);
+
+        // `aligned_alloc` wants a multiple of the alignment
+        auto const a = static_cast<std::size_t>(align);
+        auto const p = a <= alignof(std::max_align_t)
+                           ? std::malloc(n ? n : 1)
+                           : std::aligned_alloc(a, (n + a - 1) / a * a);
+        if (p)
+            return p;
+
+        throw std::bad_alloc{};
+    }
+}
+
+void *operator new(std::size_t n) { return counted_alloc(n); }
+void *operator new[](std::size_t n) { return counted_alloc(n); }
+void *operator new(std::size_t n, std::align_val_t a) { return counted_alloc(n, a); }
+void *operator new[](std::size_t n, std::align_val_t a) { return counted_alloc(n, a); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+int main(int argc, char **argv)
+{
+    char const *json_path = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            json_path = argv[++i];
+        else
+        {
+            std::printf("Usage: %s [--json <path>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    timers_bench::check_next_due();
+    for (std::size_t n : {1'000, 100'000, 1'000'000})
+        timers_bench::run(n);
+
+    for (std::size_t n : {1'000, 100'000, 1'000'000})
+        timers_bench::run_remove(n);
+
+    for (std::size_t n : {100, 10'000, 100'000})
+        stages_bench::run(n);
+
+    for (std::size_t n : {1, 100, 10'000})
+        events_bench::run(n);
+
+    for (std::size_t n : {1'000, 100'000})
+        channels_bench::run(n);
+
+    for (std::size_t n : {10, 1'000, 100'000})
+        tasks_bench::run(n);
+
+    if (json_path)
+    {
+        auto out = std::fopen(json_path, "w");
+        if (!out)
+        {
+            std::printf("ERROR: couldn't open %s\n", json_path);
+            return 1;
+        }
+
+        write_json(out);
+        std::fclose(out);
+    }
+
+    if (failed_checks != 0)
+    {
+        std::printf("ERROR: %zu checks failed\n", failed_checks);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "coro/stage.hpp"
+#include "bench.hpp"
+#include "legacy_stage.hpp"
+
+// Resume throughput of `stage_info` against the `std::queue` based stage it replaced (see legacy_stage.hpp).
+// `n` coroutines do nothing but `co_await sched()` for a number of frames; allocations are counted per frame once both are warmed up.
+// Then `n` coroutines sleep once each, for up to a second, while the stage runs on a simulated 16ms frame clock.
+
+namespace stages_bench
+{
+    inline constexpr std::size_t frames = 100;
+
+    template <typename Stage>
+    inline auto spin(Stage &s, std::size_t frames, std::size_t &done) -> fire_and_forget
+    {
+        for (std::size_t i{}; i < frames; ++i)
+            co_await s.sched();
+
+        ++done;
+    }
+
+    template <typename Stage>
+    inline auto nap(Stage &s, Uint64 ms, std::size_t &done) -> fire_and_forget
+    {
+        co_await s.sleep(ms);
+        ++done;
+    }
+
+    inline void print_per_frame(bench_result const &r)
+    {
+        report(r);
+        std::printf("%-40s %.2f allocs/frame\n", r.name, double(r.allocations) / frames);
+    }
+
+    inline void run(std::size_t n)
+    {
+        std::vector<trace> traces;
+        std::size_t done = 0;
+
+        {
+            legacy::stage s;
+            for (std::size_t i{}; i < n; ++i)
+                spin(s, frames + 1, done);
+
+            s.run_into(traces); // warm up
+
+            print_per_frame(measure("legacy_stage/resume", n * frames, [&]
+                                    {
+                                        for (std::size_t f{}; f < frames; ++f)
+                                        {
+                                            traces.clear();
+                                            s.run_into(traces);
+                                        }
+                                    }));
+        }
+
+        {
+            stage_info s;
+            for (std::size_t i{}; i < n; ++i)
+                spin(s, frames + 1, done);
+
+            traces.clear();
+            s.run_into(SDL_GetTicksNS(), traces); // warm up
+
+            print_per_frame(measure("stage_info/resume", n * frames, [&]
+                                    {
+                                        for (std::size_t f{}; f < frames; ++f)
+                                        {
+                                            traces.clear();
+                                            s.run_into(SDL_GetTicksNS(), traces);
+                                        }
+                                    }));
+        }
+
+        {
+            stage_info s;
+            auto now = SDL_GetTicksNS();
+            s.run_into(now, traces);
+
+            std::mt19937_64 rng{n};
+            std::uniform_int_distribution<Uint64> dist{1, 1000};
+
+            report(measure("stage_info/sleep", n, [&]
+                           {
+                               for (std::size_t i{}; i < n; ++i)
+                                   nap(s, dist(rng), done);
+                           }));
+
+            report(measure("stage_info/sleep_expire+resume", n, [&]
+                           {
+                               while (done < 3 * n)
+                               {
+                                   now += 16 * SDL_NS_PER_MS;
+                                   traces.clear();
+                                   s.run_into(now, traces);
+                               }
+                           }));
+        }
+
+        if (done != 3 * n)
+            fail("stages: expected %zu coroutines to finish, got %zu\n", 3 * n, done);
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "coro/race.hpp"
+#include "coro/stage.hpp"
+#include "coro/task.hpp"
+#include "coro/timeout.hpp"
+#include "bench.hpp"
+
+// Structured concurrency helpers: how deep `task<T>` chains cost, how `race_scope` scales with the number of racers, and how much a `timeout()` costs to set up.
+
+namespace tasks_bench
+{
+    // every level of a chain nests in the one awaiting it, and unoptimized builds keep a frame on the stack for each of them
+    inline constexpr std::size_t max_depth = 10'000;
+
+    inline task<std::size_t> depth(std::size_t n)
+    {
+        if (n == 0)
+            co_return 0;
+
+        co_return 1 + co_await depth(n - 1);
+    }
+
+    inline auto chain(std::size_t n, std::size_t &out) -> fire_and_forget
+    {
+        out = co_await depth(n);
+    }
+
+    // racer `i` needs `i + 1` steps, so racer 0 always wins
+    inline auto racer(race_scheduler &race, std::size_t steps) -> racing_coro
+    {
+        for (std::size_t i{}; i < steps; ++i)
+            co_await race.sched();
+    }
+
+    inline auto race_of(stage_info &s, std::size_t n, std::uint32_t &winner) -> fire_and_forget
+    {
+        winner = co_await race_scope(s, [&](race_scheduler &race)
+                                     {
+                                         for (std::size_t i{}; i < n; ++i)
+                                             racer(race, i + 1);
+                                     });
+    }
+
+    inline void run(std::size_t n)
+    {
+        std::vector<trace> traces;
+
+        {
+            auto const levels = std::min(n, max_depth);
+            std::size_t got = 0;
+            report(measure("task/chain_depth", levels, [&]
+                           { chain(levels, got); }));
+
+            if (got != levels)
+                fail("tasks: expected a chain of %zu, got %zu\n", levels, got);
+        }
+
+        {
+            stage_info s;
+            std::uint32_t winner = ~std::uint32_t{};
+
+            report(measure("race_scope/racers", n, [&]
+                           {
+                               race_of(s, n, winner);
+                               while (winner == ~std::uint32_t{})
+                                   s.run_into(SDL_GetTicksNS(), traces);
+                           }));
+
+            if (winner != 0)
+                fail("tasks: expected racer 0 to win, got %u\n", winner);
+        }
+
+        {
+            stage_info s;
+            std::vector<std::stop_token> tokens(n);
+
+            report(measure("timeout/create", n, [&]
+                           {
+                               for (auto &&t : tokens)
+                                   t = timeout(s, 1000);
+                           }));
+
+            // let every timeout fire, so their frames are freed
+            s.run_into(SDL_GetTicksNS() + 2 * SDL_NS_PER_SECOND, traces);
+
+            for (auto &&t : tokens)
+            {
+                if (!t.stop_requested())
+                {
+                    fail("tasks: a timeout didn't fire\n");
+                    break;
+                }
+            }
+        }
+    }
+}
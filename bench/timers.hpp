@@ -0,0 +1,179 @@
+#pragma once
+
+#include <coroutine>
+#include <queue>
+#include <random>
+#include <source_location>
+#include <vector>
+
+#include "coro/timer_wheel.hpp"
+#include "bench.hpp"
+
+// `timer_wheel` against the binary heap that `stage_info` used before.
+// Every sleeper gets a deadline within the next second and the clock moves in 16ms frames until all of them expire.
+
+namespace timers_bench
+{
+    inline constexpr std::uint64_t frame_ms = 16;
+    inline constexpr std::uint64_t spread_ms = 1000;
+
+    struct heap_entry final
+    {
+        std::coroutine_handle<> hnd;
+        std::source_location suspend_point;
+        std::uint64_t when_ready;
+
+        friend constexpr bool operator>(heap_entry const &lhs, heap_entry const &rhs) noexcept
+        {
+            return lhs.when_ready > rhs.when_ready;
+        }
+    };
+
+    inline std::vector<std::uint64_t> deadlines(std::size_t n)
+    {
+        std::mt19937_64 rng{n};
+        std::uniform_int_distribution<std::uint64_t> dist{1, spread_ms};
+
+        std::vector<std::uint64_t> out(n);
+        for (auto &&d : out)
+            d = dist(rng);
+
+        return out;
+    }
+
+    inline void run(std::size_t n)
+    {
+        auto const when = deadlines(n);
+        auto const sl = std::source_location::current();
+        std::size_t expired = 0;
+
+        {
+            std::priority_queue<heap_entry, std::vector<heap_entry>, std::greater<>> heap;
+
+            report(measure("heap/insert", n, [&]
+                           {
+                               for (auto w : when)
+                                   heap.push({std::noop_coroutine(), sl, w});
+                           }));
+
+            report(measure("heap/expire", n, [&]
+                           {
+                               for (std::uint64_t now = 0; !heap.empty(); now += frame_ms)
+                               {
+                                   while (!heap.empty() && heap.top().when_ready <= now)
+                                   {
+                                       heap.pop();
+                                       ++expired;
+                                   }
+                               }
+                           }));
+        }
+
+        {
+            // NOTE: the nodes live in the awaiters of the sleeping coroutines, here they're just preallocated
+            std::vector<timer_node> nodes(n);
+            timer_wheel wheel{0};
+
+            report(measure("timer_wheel/insert", n, [&]
+                           {
+                               for (std::size_t i{}; i < n; ++i)
+                               {
+                                   nodes[i].when = when[i];
+                                   wheel.insert(nodes[i]);
+                               }
+                           }));
+
+            report(measure("timer_wheel/expire", n, [&]
+                           {
+                               for (std::uint64_t now = 0; !wheel.is_empty(); now += frame_ms)
+                               {
+                                   timer_list due;
+                                   wheel.advance(now, due);
+                                   expired += due.size;
+                               }
+                           }));
+        }
+
+        if (expired != 2 * n)
+            fail("timers: expected %zu expirations, got %zu\n", 2 * n, expired);
+    }
+
+    // Taking timers out before they expire (eg. a sleep cancelled by its stop token), wherever they are in the wheel, and once they expired already
+    inline void run_remove(std::size_t n)
+    {
+        std::vector<timer_node> nodes(n);
+        std::size_t removed = 0;
+
+        auto fill = [&](timer_wheel &wheel, std::uint64_t min, std::uint64_t max)
+        {
+            std::mt19937_64 rng{n};
+            std::uniform_int_distribution<std::uint64_t> dist{min, max};
+            for (auto &&node : nodes)
+            {
+                node.when = dist(rng);
+                wheel.insert(node);
+            }
+        };
+
+        auto remove_all = [&](timer_wheel &wheel)
+        {
+            for (auto &&node : nodes)
+                removed += wheel.remove(node);
+        };
+
+        {
+            timer_wheel wheel{0};
+            fill(wheel, 1, timer_wheel::slot_count - 1);
+            report(measure("timer_wheel/remove_level0", n, [&]
+                           { remove_all(wheel); }));
+        }
+
+        {
+            timer_wheel wheel{0};
+            fill(wheel, timer_wheel::slot_count, 100 * spread_ms);
+            report(measure("timer_wheel/remove_level1+", n, [&]
+                           { remove_all(wheel); }));
+        }
+
+        if (removed != 2 * n)
+            fail("timers: expected %zu removals, got %zu\n", 2 * n, removed);
+
+        {
+            timer_wheel wheel{0};
+            fill(wheel, 1, spread_ms);
+
+            timer_list due;
+            wheel.advance(spread_ms, due);
+
+            report(measure("timer_wheel/remove_expired", n, [&]
+                           { remove_all(wheel); }));
+        }
+
+        if (removed != 2 * n)
+            fail("timers: removed %zu timers that had expired already\n", removed - 2 * n);
+    }
+
+    // A timer parked on level 1, in the slot the wheel is in: it's a full lap ahead, not due right away
+    inline void check_next_due()
+    {
+        std::uint64_t const now = 10;
+        timer_wheel wheel{now};
+
+        timer_node node;
+        node.when = now + timer_wheel::slot_count * timer_wheel::slot_count - 5;
+        wheel.insert(node);
+
+        auto const due = wheel.next_due();
+        if (due <= now || due > node.when)
+            fail("timers: expected next_due in (%llu, %llu], got %llu\n", (unsigned long long)now, (unsigned long long)node.when, (unsigned long long)due);
+
+        timer_list out;
+        wheel.advance(node.when - 1, out);
+        if (!out.is_empty())
+            fail("timers: a level 1 timer expired %llu ticks early\n", (unsigned long long)(node.when - 1 - now));
+
+        wheel.advance(node.when, out);
+        if (out.size != 1)
+            fail("timers: a level 1 timer didn't expire on time\n");
+    }
+}
@@ -5,8 +5,17 @@
 #include <SDL3/SDL_iostream.h>
 #include <SDL3/SDL_messagebox.h>
 
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <utility>
+
 #include "coro/fire_and_forget.hpp"
 #include "coro/stage.hpp"
+#include "coro/sync/semaphore.hpp"
+#include "coro/task.hpp"
+#include "utils/intrusive_list.hpp"
+#include "utils/spin_lock.hpp"
 
 struct async_io final
 {
@@ -27,39 +36,60 @@ struct async_io final
     // TODO: run_on(scheduler)
     inline fire_and_forget run_on(stage_info &s);
 
+    // Return a `SDL_IOStream` to the desired path when `co_await`, or `nullptr` if it couldn't be read. Must close the given iostream. SDL loader functions usually provide a `closeio` parameter to help with that.
+    // NOTE: waits for a spot first, see `set_max_in_flight`
+    inline task<SDL_IOStream *> read(char const *path);
+
+    // Cap how many reads are in the `SDL_AsyncIOQueue` at once, eg. when thousands of loads start together; there is no cap by default.
+    // The other reads wait in line and go in, in order, as the ones before them complete; they resume on `s` to do so.
+    // NOTE: call before the first read
+    inline void set_max_in_flight(stage_info &s, std::size_t n) { slots.emplace(s, n); }
+
+private:
     struct read_awaiter;
-    // Return a `SDL_IOStream` to the desired path when `co_await`. Must close the given iostream. SDL loader functions usually provide a `closeio` parameter to help with that.
+
+    // The read itself, right away
     [[nodiscard("Must be `co_await`")]]
-    inline read_awaiter read(char const *path) noexcept;
+    inline read_awaiter read_now(char const *path) noexcept;
+
+    // Hand `awt` to SDL; a read SDL refuses completes with nothing, see `run_on`
+    inline void submit(read_awaiter *awt);
 
-private:
     SDL_AsyncIOQueue *queue;
+    std::optional<async_semaphore> slots; // one unit per read allowed in the queue, see `set_max_in_flight`
+
+    // v-- guarded by `lock`, since coroutines running on workers can read
+    spin_lock lock;
+    intrusive_list<read_awaiter> refused; // reads SDL didn't take, waiting for `run_on` to resume them
 };
 
 struct async_io::read_awaiter final
 {
-    SDL_AsyncIOQueue *queue;
+    async_io *io;
     char const *path;
-    std::coroutine_handle<> then;
+    coro_state state;
     size_t buff_size;
     void *buff;
+    read_awaiter *next = nullptr; // see `async_io::refused`
 
     static constexpr bool await_ready() noexcept { return false; }
 
-    inline auto await_suspend(std::coroutine_handle<> hnd) noexcept
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd,
+                              std::source_location const &sl = std::source_location::current()) noexcept
     {
-        then = hnd;
-        if (!SDL_LoadFileAsync(path, queue, this))
-        {
-            // TODO: better error message
-            SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Failed to submit async load job", SDL_GetError(), nullptr);
-        }
+        state = coro_state::of(hnd, sl, stage_info::current_thread());
+        io->submit(this);
 
         // TODO: signal the "run_on" task to start polling again if in sleep
+        return stage_info::transfer(hnd);
     }
 
     inline auto await_resume() noexcept -> SDL_IOStream *
     {
+        if (!buff)
+            return nullptr;
+
         // TODO: how does this interact with pngs/etc. since fonts were a "special case"?
         auto stream = SDL_IOFromConstMem(buff, buff_size);
         SDL_SetPointerProperty(
@@ -69,9 +99,36 @@ struct async_io::read_awaiter final
         return stream;
     }
 };
-inline async_io::read_awaiter async_io::read(char const *path) noexcept
+inline async_io::read_awaiter async_io::read_now(char const *path) noexcept
 {
-    return read_awaiter{queue, path};
+    return read_awaiter{this, path};
+}
+
+inline task<SDL_IOStream *> async_io::read(char const *path)
+{
+    if (!slots)
+        co_return co_await read_now(path);
+
+    co_await slots->acquire();
+    auto stream = co_await read_now(path);
+    slots->release(); // the spot goes to the next read in line
+
+    co_return stream;
+}
+
+inline void async_io::submit(read_awaiter *awt)
+{
+    if (SDL_LoadFileAsync(awt->path, queue, awt))
+        return;
+
+    // TODO: better error message
+    SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Failed to submit async load job", SDL_GetError(), nullptr);
+
+    awt->buff = nullptr;
+    awt->buff_size = 0;
+
+    std::scoped_lock lk{lock};
+    refused.push_one(*awt);
 }
 
 inline fire_and_forget async_io::run_on(stage_info &s)
@@ -91,8 +148,22 @@ inline fire_and_forget async_io::run_on(stage_info &s)
             auto awt = (read_awaiter *)out.userdata;
             awt->buff_size = out.bytes_transferred;
             awt->buff = out.buffer;
+            awt->state.woken_by(current_coro, flow_kind::io); // this polling coroutine
             // HACK: better scheduling
-            s.schedule(awt->then);
+            s.schedule(awt->state);
+        }
+
+        // resume the reads SDL refused, with nothing
+        intrusive_list<read_awaiter> failed;
+        {
+            std::scoped_lock lk{lock};
+            failed = std::exchange(refused, {});
+        }
+
+        while (auto awt = failed.pop())
+        {
+            awt->state.woken_by(current_coro, flow_kind::io);
+            s.schedule(awt->state);
         }
 
         co_await s.sched();
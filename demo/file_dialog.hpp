@@ -76,23 +76,27 @@ struct file_dialog::open_file_awaiter final
 {
     stage_info *s;
     open_file_cfg const *cfg;
-    std::coroutine_handle<> then;
+    coro_state state;
     int which_filter;
     uint32_t files_count;
     std::unique_ptr<std::string[]> files;
 
     static constexpr bool await_ready() noexcept { return false; }
 
-    // TODO: resume the next task here as optimization
-    inline auto await_suspend(std::coroutine_handle<> hnd) noexcept
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd,
+                              std::source_location const &sl = std::source_location::current()) noexcept
     {
-        then = hnd;
+        state = coro_state::of(hnd, sl, stage_info::current_thread());
         SDL_ShowOpenFileDialog(
             (SDL_DialogFileCallback)callback, this,
             cfg->win,
             cfg->filters.data(), cfg->filters.size(),
             cfg->default_location, cfg->allow_many //
         );
+
+        // the dialog resumes us from its callback; meanwhile the stage goes on with the next coroutine
+        return stage_info::transfer(hnd);
     }
 
     inline result await_resume() noexcept
@@ -109,7 +113,8 @@ private:
     {
         awt->files = copy_list(filelist, awt->files_count);
         awt->which_filter = filter;
-        awt->s->schedule(awt->then);
+        awt->state.woken_by(0, flow_kind::io); // no coroutine woke it up, the user did
+        awt->s->schedule(awt->state);
     }
 };
 inline file_dialog::open_file_awaiter file_dialog::open_file(stage_info &s, open_file_cfg const &cfg) noexcept { return open_file_awaiter{&s, &cfg}; }
@@ -118,23 +123,26 @@ struct file_dialog::save_file_awaiter final
 {
     stage_info *s;
     save_file_cfg const *cfg;
-    std::coroutine_handle<> then;
+    coro_state state;
     int which_filter;
     uint32_t files_count;
     std::unique_ptr<std::string[]> files;
 
     static constexpr bool await_ready() noexcept { return false; }
 
-    // TODO: resume the next task here as optimization
-    inline auto await_suspend(std::coroutine_handle<> hnd) noexcept
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd,
+                              std::source_location const &sl = std::source_location::current()) noexcept
     {
-        then = hnd;
+        state = coro_state::of(hnd, sl, stage_info::current_thread());
         SDL_ShowSaveFileDialog(
             (SDL_DialogFileCallback)callback, this,
             cfg->win,
             cfg->filters.data(), cfg->filters.size(),
             cfg->default_location //
         );
+
+        return stage_info::transfer(hnd);
     }
 
     inline result await_resume() noexcept
@@ -151,7 +159,8 @@ private:
     {
         awt->files = copy_list(filelist, awt->files_count);
         awt->which_filter = filter;
-        awt->s->schedule(awt->then);
+        awt->state.woken_by(0, flow_kind::io); // no coroutine woke it up, the user did
+        awt->s->schedule(awt->state);
     }
 };
 inline file_dialog::save_file_awaiter file_dialog::save_file(stage_info &s, save_file_cfg const &cfg) noexcept { return save_file_awaiter{&s, &cfg}; }
@@ -160,22 +169,25 @@ struct file_dialog::open_folder_awaiter final
 {
     stage_info *s;
     open_folder_cfg const *cfg;
-    std::coroutine_handle<> then;
+    coro_state state;
     int which_filter;
     uint32_t files_count;
     std::unique_ptr<std::string[]> files;
 
     static constexpr bool await_ready() noexcept { return false; }
 
-    // TODO: resume the next task here as optimization
-    inline auto await_suspend(std::coroutine_handle<> hnd) noexcept
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd,
+                              std::source_location const &sl = std::source_location::current()) noexcept
     {
-        then = hnd;
+        state = coro_state::of(hnd, sl, stage_info::current_thread());
         SDL_ShowOpenFolderDialog(
             (SDL_DialogFileCallback)callback, this,
             cfg->win,
             cfg->default_location, cfg->allow_many //
         );
+
+        return stage_info::transfer(hnd);
     }
 
     inline result await_resume() noexcept
@@ -192,7 +204,8 @@ private:
     {
         awt->files = copy_list(filelist, awt->files_count);
         awt->which_filter = filter;
-        awt->s->schedule(awt->then);
+        awt->state.woken_by(0, flow_kind::io); // no coroutine woke it up, the user did
+        awt->s->schedule(awt->state);
     }
 };
 inline file_dialog::open_folder_awaiter file_dialog::open_folder(stage_info &s, open_folder_cfg const &cfg) noexcept { return open_folder_awaiter{&s, &cfg}; }
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+
+#include <SDL3/SDL_events.h>
+#include <SDL3/SDL_timer.h>
+
+#include "coro/scheduler.hpp"
+
+// Waits between frames so that they start `period` ns apart, without burning the CPU.
+// The thread blocks in `SDL_WaitEventTimeout` until the next frame is due, a sleeping coroutine is due or an event comes in, whichever is first;
+// only the last `spin` ns are spent spinning on the clock, to start the frame on time despite the coarse sleeps (eg. on a dedicated core).
+struct frame_pacer final
+{
+    // `period` is the target frame time in ns (`0` doesn't wait at all), `spin` how long to spin at the end of a wait
+    inline explicit frame_pacer(Uint64 period, Uint64 spin = 0) noexcept
+        : period{period}, spin{spin} {}
+
+    // Call once per frame, after the frame is done; returns once the next one should start
+    inline void wait(scheduler &sched);
+
+    // Call at the start of every frame, whether `wait` is used or not, to measure the interval between frames
+    inline void frame_started() noexcept
+    {
+        auto const now = SDL_GetTicksNS();
+        interval = last_start ? now - last_start : 0;
+        last_start = now;
+    }
+
+    // time between the starts of the last two frames, ns; `0` for the first one
+    [[nodiscard]]
+    inline Uint64 last_interval() const noexcept { return interval; }
+
+private:
+    Uint64 const period, spin;
+    Uint64 next = 0; // when the next frame is due
+    Uint64 last_start = 0, interval = 0;
+};
+
+inline void frame_pacer::wait(scheduler &sched)
+{
+    if (period == 0)
+        return;
+
+    auto now = SDL_GetTicksNS();
+    if (next == 0)
+        next = now + period;
+
+    // with a fixed step, the sleepers' time only moves with the frames, so waking up for them early doesn't help
+    auto const due = sched.is_fixed_step() ? next : std::min(next, sched.next_due());
+
+    // coarse sleep, waking up for events; SDL only waits in whole ms
+    if (due > now + spin + SDL_NS_PER_MS)
+    {
+        auto const ms = (due - now - spin) / SDL_NS_PER_MS;
+        if (SDL_WaitEventTimeout(nullptr, Sint32(std::min<Uint64>(ms, SDL_MAX_SINT32))))
+            return; // an event is waiting: handle it now, the next frame is still due when it was
+
+        now = SDL_GetTicksNS();
+    }
+
+    if (due > now + spin)
+        SDL_DelayNS(due - now - spin);
+
+    while (SDL_GetTicksNS() < due)
+        ;
+
+    // woken up early by a sleeper: the next frame is still due when it was
+    if (due < next)
+        return;
+
+    // a frame that ran late doesn't make the next ones go faster to catch up
+    next += period;
+    if (now = SDL_GetTicksNS(); next <= now)
+        next = now + period;
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "coro/stage.hpp"
+
+// Collects the timings of every frame, eg. for headless runs.
+// `write` sums them up (mean, p50, p99, max) per frame and per stage, along with the live coroutines and their memory (also per coroutine function), followed by every trace, as JSON.
+struct frame_stats final
+{
+    // what a stage is called in the output; the built-in stages are named already, the others show their id
+    inline void name_stage(stage_id sid, std::string_view name)
+    {
+        series_of(sid).name = name;
+    }
+
+    // settings of the run, written as is (eg. how many entities a stress run spawned)
+    inline void param(std::string_view key, std::size_t value)
+    {
+        for (auto &&[k, v] : params)
+        {
+            if (k == key)
+            {
+                v = value;
+                return;
+            }
+        }
+
+        params.emplace_back(key, value);
+    }
+
+    // `coroutines` and `frame_bytes` are what the frame allocators have live / reserved at the end of the frame,
+    // `interval` the time since the previous frame started (see `frame_pacer`), `0` when unknown
+    inline void record(context const &ctx, std::size_t coroutines, std::size_t frame_bytes, Uint64 interval = 0)
+    {
+        // jitter: how much the interval changed since the previous frame, whatever the pacing
+        if (interval)
+        {
+            if (!intervals.empty())
+                jitter.push_back(interval > intervals.back() ? interval - intervals.back() : intervals.back() - interval);
+            intervals.push_back(interval);
+        }
+
+        wall.push_back(ctx.frame.wall);
+        work.push_back(ctx.frame.work);
+        critical_path.push_back(ctx.frame.critical_path);
+        live_coroutines.push_back(coroutines);
+        frame_memory.push_back(frame_bytes);
+
+        for (auto &&st : ctx.stage_times)
+            series_of(st.stage).durations.push_back(st.duration);
+    }
+
+    [[nodiscard]]
+    inline std::size_t frames() const noexcept { return wall.size(); }
+
+    inline void write(FILE *out, trace_ring const &traces) const;
+
+    // one line with the params and how the frame time, coroutines and frame memory did; eg. to compare runs of different sizes
+    inline void print_summary(FILE *out) const;
+
+private:
+    struct stage_series final
+    {
+        stage_id sid;
+        std::string_view name;
+        std::vector<Uint64> durations; // ns, one per frame
+    };
+
+    inline stage_series &series_of(stage_id sid)
+    {
+        auto const it = std::find_if(stages.begin(), stages.end(), [&](stage_series const &s)
+                                     { return s.sid == sid; });
+        if (it != stages.end())
+            return *it;
+
+        return stages.emplace_back(stage_series{.sid = sid, .name = builtin_stage_name(sid)});
+    }
+
+    struct summary final
+    {
+        Uint64 mean = 0, p50 = 0, p99 = 0, max = 0;
+    };
+
+    inline static summary summarize(std::vector<Uint64> values);
+
+    inline static void write_summary(FILE *out, std::vector<Uint64> const &values);
+
+    std::vector<std::pair<std::string_view, std::size_t>> params;
+    std::vector<Uint64> wall, work, critical_path;     // ns, one per frame
+    std::vector<Uint64> intervals, jitter;             // ns, one per frame after the first one (two for `jitter`)
+    std::vector<Uint64> live_coroutines, frame_memory; // one per frame; frame memory is in bytes
+    std::vector<stage_series> stages;
+};
+
+inline frame_stats::summary frame_stats::summarize(std::vector<Uint64> values)
+{
+    if (values.empty())
+        return {};
+
+    std::sort(values.begin(), values.end());
+
+    Uint64 sum = 0;
+    for (auto v : values)
+        sum += v;
+
+    // nearest rank
+    auto percentile = [&](std::size_t p)
+    {
+        auto const rank = (values.size() * p + 99) / 100;
+        return values[std::max<std::size_t>(rank, 1) - 1];
+    };
+
+    return {
+        .mean = sum / values.size(),
+        .p50 = percentile(50),
+        .p99 = percentile(99),
+        .max = values.back(),
+    };
+}
+
+inline void frame_stats::write_summary(FILE *out, std::vector<Uint64> const &values)
+{
+    auto const s = summarize(values);
+    std::fprintf(
+        out, "{\"mean\": %llu, \"p50\": %llu, \"p99\": %llu, \"max\": %llu}",
+        (unsigned long long)s.mean, (unsigned long long)s.p50, (unsigned long long)s.p99, (unsigned long long)s.max //
+    );
+}
+
+inline void frame_stats::write(FILE *out, trace_ring const &traces) const
+{
+    std::fprintf(out, "{\n  \"unit\": \"ns\",\n  \"frames\": %zu,\n", frames());
+
+    for (auto &&[key, value] : params)
+        std::fprintf(out, "  \"%.*s\": %zu,\n", int(key.size()), key.data(), value);
+
+    // v-- not timings, but they scale with the scene all the same
+    std::fprintf(out, "  \"coroutines\": ");
+    write_summary(out, live_coroutines);
+    std::fprintf(out, ",\n  \"frame_memory\": ");
+    write_summary(out, frame_memory);
+    std::fprintf(out, ",\n");
+
+    std::fprintf(out, "  \"frame\": {\n");
+    std::pair<char const *, std::vector<Uint64> const *> const frame_series[] = {
+        {"wall", &wall},
+        {"work", &work},
+        {"critical_path", &critical_path},
+        {"interval", &intervals},
+        {"jitter", &jitter},
+    };
+    for (std::size_t i{}; i < std::size(frame_series); ++i)
+    {
+        std::fprintf(out, "    \"%s\": ", frame_series[i].first);
+        write_summary(out, *frame_series[i].second);
+        std::fprintf(out, i + 1 < std::size(frame_series) ? ",\n" : "\n");
+    }
+    std::fprintf(out, "  },\n");
+
+    std::fprintf(out, "  \"stages\": [\n");
+    for (std::size_t i{}; i < stages.size(); ++i)
+    {
+        auto &&s = stages[i];
+
+        std::fprintf(out, "    {\"id\": %u, \"name\": \"%.*s\", \"duration\": ", unsigned(s.sid), int(s.name.size()), s.name.data());
+        write_summary(out, s.durations);
+        std::fprintf(out, i + 1 < stages.size() ? "},\n" : "}\n");
+    }
+    std::fprintf(out, "  ],\n");
+
+    // what is still alive at the end of the run shows the frames that leak
+    auto const functions = frame_usage::global().stats();
+    std::fprintf(out, "  \"frames_by_function\": [\n");
+    for (std::size_t i{}; i < functions.size(); ++i)
+    {
+        auto &&f = functions[i];
+        std::fprintf(
+            out, "    {\"name\": \"%.*s\", \"frame_size\": %zu, \"live\": %zu, \"peak\": %zu, \"created\": %zu, \"bytes_peak\": %zu}%s\n",
+            int(f.name.size()), f.name.data(), f.frame_size, f.live, f.peak, f.created, f.bytes_peak,
+            i + 1 < functions.size() ? "," : "" //
+        );
+    }
+    std::fprintf(out, "  ],\n");
+
+    // only the newest traces are left in the ring
+    std::fprintf(out, "  \"traces_dropped\": %llu,\n", (unsigned long long)(traces.total() - traces.size()));
+
+    // NOTE: function names don't have quotes or backslashes, so they go as is
+    std::fprintf(out, "  \"traces\": [\n");
+    traces.for_each(0, traces.size(), [&, i = std::size_t{}](trace const &t) mutable
+    {
+        std::fprintf(
+            out,
+            "    {\"name\": \"%.*s\", \"line\": %u, \"stage\": %u, \"thread\": %zu, \"wait_start\": %llu, \"wait_finish\": %llu, \"start\": %llu, \"finish\": %llu, "
+            "\"coro\": \"%#llx\", \"parent\": \"%#llx\", \"waker\": \"%#llx\", \"flow\": \"%.*s\"}%s\n",
+            int(t.name().size()), t.name().data(), unsigned(t.line()), unsigned(t.stage), std::hash<std::thread::id>{}(t.tid),
+            (unsigned long long)t.wait_start, (unsigned long long)t.wait_finish,
+            (unsigned long long)t.start, (unsigned long long)t.finish,
+            (unsigned long long)t.id, (unsigned long long)t.parent, (unsigned long long)t.waker, int(flow_name(t.flow).size()), flow_name(t.flow).data(),
+            ++i < traces.size() ? "," : "" //
+        );
+    });
+    std::fprintf(out, "  ]\n}\n");
+}
+
+inline void frame_stats::print_summary(FILE *out) const
+{
+    for (auto &&[key, value] : params)
+        std::fprintf(out, "%.*s=%zu ", int(key.size()), key.data(), value);
+
+    auto const wall_time = summarize(wall);
+    auto const coroutines = summarize(live_coroutines);
+    auto const memory = summarize(frame_memory);
+    auto const jitters = summarize(jitter);
+
+    std::fprintf(
+        out, "frames=%zu frame_ms(mean/p99/max)=%.3f/%.3f/%.3f jitter_ms(mean/p99/max)=%.3f/%.3f/%.3f coroutines(mean/max)=%llu/%llu frame_memory_kib(max)=%llu\n",
+        frames(),
+        double(wall_time.mean) / SDL_NS_PER_MS, double(wall_time.p99) / SDL_NS_PER_MS, double(wall_time.max) / SDL_NS_PER_MS,
+        double(jitters.mean) / SDL_NS_PER_MS, double(jitters.p99) / SDL_NS_PER_MS, double(jitters.max) / SDL_NS_PER_MS,
+        (unsigned long long)coroutines.mean, (unsigned long long)coroutines.max,
+        (unsigned long long)(memory.max / 1024) //
+    );
+}
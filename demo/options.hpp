@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <SDL3/SDL_timer.h>
+
+// Command-line options of the demo
+struct demo_options final
+{
+    // no display needed: offscreen video driver + software renderer, a fixed number of frames on a fixed timestep, no frame pacing unless `--fps` is given
+    bool headless = false;
+
+    std::size_t fps = 60; // frame rate to pace the frames at, see `frame_pacer`; `0` only waits 1 ms between frames (none when headless)
+    Uint64 spin = 0;      // ns; how long to spin before a frame starts instead of sleeping, for less jitter
+
+    std::size_t frames = 0;           // stop after that many frames; `0` runs until the window is closed
+    Uint64 step = 0;                  // ns; fixed timestep, `0` follows the clock
+    char const *stats_path = nullptr; // where to write the frame timings + traces when done, see `frame_stats`
+
+    std::size_t trace_mib = 0;          // memory ceiling of the trace history, `0` keeps the default (see `trace_ring`)
+    char const *chrome_trace = nullptr; // where to stream the traces as they come, see `trace_exporter`
+
+    // spawn that many patrollers, color boxes, zoom boxes and text lines on top of the demo, to see how it scales
+    std::size_t stress = 0;
+};
+
+inline void print_usage(char const *exe)
+{
+    std::printf(
+        "Usage: %s [--headless] [--frames <n>] [--step-ms <ms>] [--stats <path>] [--fps <n>] [--spin-us <us>] [--stress <n>] [--trace-mib <n>] [--chrome-trace <path>]\n"
+        "  --headless       offscreen video driver + software renderer;\n"
+        "                   defaults to --frames 600 --step-ms 16.667 --stats headless_stats.json --fps 0\n"
+        "  --frames <n>     stop after n frames\n"
+        "  --step-ms <ms>   advance the time by exactly that much every frame\n"
+        "  --stats <path>   write per-frame and per-stage timings (mean, p50, p99, max) and the traces as JSON\n"
+        "  --fps <n>        start the frames at n per second, sleeping in between (default 60);\n"
+        "                   0 waits 1 ms between frames instead\n"
+        "  --spin-us <us>   spin for the last us microseconds before a frame rather than sleep, for less jitter\n"
+        "  --stress <n>     spawn n of each entity (patrollers, color boxes, zoom boxes, text lines);\n"
+        "                   prints how frame time, coroutines and frame memory did when done\n"
+        "  --trace-mib <n>  keep at most about n MiB of traces; the oldest ones are dropped first\n"
+        "  --chrome-trace <path>\n"
+        "                   stream the traces to a Chrome Trace Event file (chrome://tracing, ui.perfetto.dev)\n",
+        exe //
+    );
+}
+
+// NOTE: prints the usage and returns `false` on bad arguments
+inline bool parse_options(int argc, char **argv, demo_options &opts)
+{
+    bool has_frames = false, has_step = false, has_fps = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        auto const arg = argv[i];
+        auto const value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (std::strcmp(arg, "--headless") == 0)
+        {
+            opts.headless = true;
+            continue;
+        }
+
+        if (!value)
+        {
+            print_usage(argv[0]);
+            return false;
+        }
+
+        char *end = nullptr;
+        if (std::strcmp(arg, "--frames") == 0)
+        {
+            opts.frames = std::strtoull(value, &end, 10);
+            has_frames = true;
+        }
+        else if (std::strcmp(arg, "--step-ms") == 0)
+        {
+            opts.step = Uint64(std::strtod(value, &end) * SDL_NS_PER_MS);
+            has_step = true;
+        }
+        else if (std::strcmp(arg, "--fps") == 0)
+        {
+            opts.fps = std::strtoull(value, &end, 10);
+            has_fps = true;
+        }
+        else if (std::strcmp(arg, "--spin-us") == 0)
+            opts.spin = Uint64(std::strtod(value, &end) * SDL_NS_PER_US);
+        else if (std::strcmp(arg, "--stress") == 0)
+            opts.stress = std::strtoull(value, &end, 10);
+        else if (std::strcmp(arg, "--trace-mib") == 0)
+            opts.trace_mib = std::strtoull(value, &end, 10);
+        else if (std::strcmp(arg, "--stats") == 0)
+        {
+            opts.stats_path = value;
+            end = value + std::strlen(value);
+        }
+        else if (std::strcmp(arg, "--chrome-trace") == 0)
+        {
+            opts.chrome_trace = value;
+            end = value + std::strlen(value);
+        }
+
+        if (!end || *end != '\0' || end == value)
+        {
+            print_usage(argv[0]);
+            return false;
+        }
+
+        ++i;
+    }
+
+    if (opts.headless)
+    {
+        if (!has_frames)
+            opts.frames = 600;
+        if (!has_step)
+            opts.step = SDL_NS_PER_SECOND / 60;
+        if (!opts.stats_path)
+            opts.stats_path = "headless_stats.json";
+
+        // as fast as it can, unless asked to pace the frames (eg. to measure the jitter with `--stats`)
+        if (!has_fps)
+            opts.fps = 0;
+    }
+
+    return true;
+}
@@ -43,6 +43,9 @@ task<> dialogue_builder::say(std::string_view who, std::string_view what)
 {
     // TODO: as a bonus, do longer pauses on punctuations.
 
+    // NOTE: entities are only created on the render stage, which never runs alongside the update workers
+    co_await sched->stages[stage_id::render].sched();
+
     // invariant: the components might not be stable (storage) but the internal pointer to the text (ie. TTF_Text *) is
     auto text = TTF_CreateText(eng, font, who.data(), who.size());
     TTF_AppendTextString(text, ": ", 2);
@@ -57,8 +60,8 @@ task<> dialogue_builder::say(std::string_view who, std::string_view what)
 
     Uint64 const
         msg_len = message.size(),
-        time_per_letter = 40,
-        duration = time_per_letter * message.size(),
+        time_per_letter = 40, // ms
+        duration = SDL_MS_TO_NS(time_per_letter * message.size()),
         start_time = ctx->time.now,
         end_time = start_time + duration;
 
@@ -98,6 +101,9 @@ task<uint32_t> dialogue_builder::choose(std::span<std::string_view const> option
     auto const old_x = position.x;
     int w, h;
 
+    // NOTE: see `say`
+    co_await sched->stages[stage_id::render].sched();
+
     for (auto opt : options)
     {
         auto text = TTF_CreateText(eng, font, opt.data(), opt.size());
@@ -1,5 +1,7 @@
 
 #include <cstdio>
+#include <memory>
+#include <optional>
 #include <span>
 
 #include <entt/entity/registry.hpp>
@@ -9,17 +11,21 @@
 #include <imgui_impl_sdlrenderer3.h>
 
 #include "coro/events/event.hpp"
+#include "coro/events/frame_events.hpp"
 
 #include "coro/scheduler.hpp"
 #include "coro/profiler_gui.hpp"
 #include "coro/timeout.hpp"
+#include "coro/trace_export.hpp"
 
 #include "demo/file_dialog.hpp"
 #include "demo/async_io.hpp"
+#include "demo/frame_pacer.hpp"
+#include "demo/frame_stats.hpp"
+#include "demo/options.hpp"
 #include "demo/text.hpp"
 
 // TODO:
-// - task allocator support
 // - SDL3_net example
 // - implicit timed-awaiter list sorted as priority queue
 /*
@@ -63,10 +69,14 @@ struct speed final
     return stage_id{entt::hashed_string::value(x, std::size(x))}; \
 }()
 
-auto constexpr imgui_stage = NAMED_STAGE("imgui");
+auto constexpr imgui_stage = NAMED_STAGE("imgui");               // widgets are built here
+auto constexpr imgui_render_stage = NAMED_STAGE("imgui_render"); // submits the widgets after everything else is drawn
+auto constexpr background_stage = NAMED_STAGE("background");     // gets whatever time is left in the frame
+auto constexpr flush_stage = NAMED_STAGE("flush");               // hands what was published during update to the subscribers of the event buses
+auto constexpr events_stage = NAMED_STAGE("events");             // the subscribers apply it here, before anything is drawn
 
 // demo: adding Dear ImGui to your game
-auto imgui_system(scheduler &sched, context &ctx, SDL_Window *win, SDL_Renderer *ren) -> fire_and_forget
+auto imgui_system(scheduler &sched, SDL_Window *win, SDL_Renderer *ren) -> fire_and_forget
 {
     // initialize ImGui during startup
     co_await sched.stages[stage_id::startup].sched();
@@ -78,24 +88,23 @@ auto imgui_system(scheduler &sched, context &ctx, SDL_Window *win, SDL_Renderer
     ImGui_ImplSDL3_InitForSDLRenderer(win, ren);
     ImGui_ImplSDLRenderer3_Init(ren);
 
+    // ImGui's SDL backends must stay on the main thread; this pins the coroutine there for all the stages below
+    co_await sched.stages[stage_id::update].on_main_thread();
+
     while (!sched.stop.stop_requested())
     {
-        // build the widgets during the update stage
-        co_await sched.stages[stage_id::update].sched();
-
         ImGui_ImplSDLRenderer3_NewFrame();
         ImGui_ImplSDL3_NewFrame();
         ImGui::NewFrame();
 
-        sched.stages[imgui_stage].run(ctx);
-
-        ImGui::Render();
-
         // submit ImGui "draw calls" after everything else so it shows up on top
-        co_await sched.stages[stage_id::render].sched();
+        co_await sched.stages[imgui_render_stage].sched();
 
-        // TODO: this must be ran after everything else
+        ImGui::Render();
         ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), ren);
+
+        // start the next frame during the update stage; `imgui_stage` runs after it and builds the widgets
+        co_await sched.stages[stage_id::update].sched();
     }
 
     // cleanup ImGui when done
@@ -128,10 +137,11 @@ inline void pos_to_rect(entt::registry &reg)
 
 auto render_task(scheduler &sched, entt::registry &reg, SDL_Renderer *ren) -> fire_and_forget
 {
+    // SDL rendering must happen on the main thread
+    co_await sched.stages[stage_id::render].on_main_thread();
+
     while (true)
     {
-        co_await sched.stages[stage_id::render].sched();
-
         pos_to_rect(reg);
 
         // render boxes
@@ -144,15 +154,17 @@ auto render_task(scheduler &sched, entt::registry &reg, SDL_Renderer *ren) -> fi
         // render text
         for (auto &&[id, text, pos] : reg.view<text_data, SDL_FPoint const>().each())
             TTF_DrawRendererText(text.text, pos.x, pos.y);
+
+        co_await sched.stages[stage_id::render].sched();
     }
 }
 
 auto timeout_showcase(scheduler &sched, std::stop_token stop) -> fire_and_forget
 {
-    // sleep-and-print but also check for cancellations (timeouts)
-    co_await sched.stages[stage_id::update].sleep(1000);
+    // sleep-and-print, but wake up as soon as the timeout hits instead of once the sleep is over
+    auto &&update = sched.stages[stage_id::update];
 
-    if (stop.stop_requested())
+    if (!co_await update.sleep(1000, stop))
     {
         std::printf("Cancelled\n");
         co_return;
@@ -160,9 +172,7 @@ auto timeout_showcase(scheduler &sched, std::stop_token stop) -> fire_and_forget
 
     std::printf("After first sleep\n");
 
-    co_await sched.stages[stage_id::update].sleep(2000);
-
-    if (stop.stop_requested())
+    if (!co_await update.sleep(2000, stop))
     {
         std::printf("Cancelled\n");
         co_return;
@@ -170,9 +180,7 @@ auto timeout_showcase(scheduler &sched, std::stop_token stop) -> fire_and_forget
 
     std::printf("After second sleep\n");
 
-    co_await sched.stages[stage_id::update].sleep(3000);
-
-    if (stop.stop_requested())
+    if (!co_await update.sleep(3000, stop))
     {
         std::printf("Cancelled\n");
         co_return;
@@ -221,11 +229,11 @@ auto move_around(scheduler &sched, context &ctx, entt::registry &reg, entt::enti
 
         // calculate how long it would take to reach the next patrol point
         auto const len = hypot(target.x - p.x, target.y - p.y);
-        auto const elapsed_time = len / (s.s / 1000.0f);
+        auto const elapsed_time = len / (s.s / float(SDL_NS_PER_SECOND));
 
         auto const start_pos = p;
         auto const start_time = ctx.time.now;
-        auto const end_time = start_time + elapsed_time;
+        auto const end_time = start_time + Uint64(elapsed_time);
 
         auto const inv_elapsed = 1.0f / elapsed_time;
 
@@ -234,9 +242,9 @@ auto move_around(scheduler &sched, context &ctx, entt::registry &reg, entt::enti
             co_await sched.stages[stage_id::update].sched();
 
             // if mouse clicked, patrol around the mouse's position when it was clicked
-            if (float mx, my; SDL_GetMouseState(&mx, &my) & SDL_BUTTON_LMASK)
+            if (ctx.mouse.buttons & SDL_BUTTON_LMASK)
             {
-                move_around(sched, ctx, reg, object, pos{mx, my}, dist);
+                move_around(sched, ctx, reg, object, pos{ctx.mouse.x, ctx.mouse.y}, dist);
                 co_return;
             }
 
@@ -254,19 +262,43 @@ auto move_around(scheduler &sched, context &ctx, entt::registry &reg, entt::enti
     }
 }
 
-inline entt::entity spawn_player(scheduler &sched, context &ctx, entt::registry &reg)
+inline entt::entity spawn_player(scheduler &sched, context &ctx, entt::registry &reg, pos center = {600.0f, 500.0f})
 {
     auto const id = reg.create();
     reg.emplace<SDL_Color>(id) = {0xff, 0x00, 0x00, 0xff};
-    reg.emplace<pos>(id) = {500.0f, 500.0f};
+    reg.emplace<pos>(id) = {center.x - 100.0f, center.y};
     reg.emplace<speed>(id, 100.0f);
 
-    move_around(sched, ctx, reg, id, pos{600.0f, 500.0f}, 100.0f);
+    move_around(sched, ctx, reg, id, center, 100.0f);
 
     return id;
 }
 
-auto change_box_color(scheduler &sched, entt::registry &reg, entt::entity box) -> fire_and_forget
+// a box changing color; only the last change of a box in a frame is applied
+struct box_color final
+{
+    entt::entity box;
+    SDL_Color color;
+
+    struct by_box final
+    {
+        inline entt::entity operator()(box_color const &c) const noexcept { return c.box; }
+    };
+};
+
+using box_color_events = frame_events<box_color, box_color::by_box>;
+
+// applies the color changes of every box in one go, once per frame that has any
+auto apply_box_colors(box_color_events &colors, entt::registry &reg) -> fire_and_forget
+{
+    while (true)
+    {
+        for (auto &&c : co_await colors)
+            reg.get<SDL_Color>(c.box) = c.color;
+    }
+}
+
+auto change_box_color(scheduler &sched, box_color_events &changes, entt::entity box) -> fire_and_forget
 {
     SDL_Color const colors[]{
         {255, 0, 0, 255},
@@ -282,19 +314,19 @@ auto change_box_color(scheduler &sched, entt::registry &reg, entt::entity box) -
     {
         for (auto c : colors)
         {
-            reg.get<SDL_Color>(box) = c;
+            changes.publish({box, c});
             co_await sched.stages[stage_id::update].sleep(500);
         }
     }
 }
 
-inline entt::entity spawn_color_box(scheduler &sched, entt::registry &reg)
+inline entt::entity spawn_color_box(scheduler &sched, entt::registry &reg, box_color_events &colors, SDL_FPoint at = {100.0f, 100.0f})
 {
     auto const id = reg.create();
-    reg.emplace<SDL_FRect>(id, 100.0f, 100.0f, 100.0f, 100.0f);
+    reg.emplace<SDL_FRect>(id, at.x, at.y, 100.0f, 100.0f);
     reg.emplace<SDL_Color>(id) = {0xff, 0x00, 0x00, 0xff};
 
-    change_box_color(sched, reg, id);
+    change_box_color(sched, colors, id);
 
     return id;
 }
@@ -320,7 +352,7 @@ auto change_box_zoom(scheduler &sched, context &ctx, entt::registry &reg, entt::
     {
         auto const
             start_time = ctx.time.now,
-            duration = Uint64(1000),
+            duration = SDL_MS_TO_NS(1000),
             end_time = start_time + duration;
 
         auto smoothstep = [](float x)
@@ -352,10 +384,10 @@ auto change_box_zoom(scheduler &sched, context &ctx, entt::registry &reg, entt::
     }
 }
 
-inline entt::entity spawn_zoom_box(scheduler &sched, context &ctx, entt::registry &reg)
+inline entt::entity spawn_zoom_box(scheduler &sched, context &ctx, entt::registry &reg, SDL_FPoint at = {400.0f, 100.0f})
 {
     auto const id = reg.create();
-    reg.emplace<SDL_FRect>(id, 400.0f, 100.0f, 100.0f, 100.0f);
+    reg.emplace<SDL_FRect>(id, at.x, at.y, 100.0f, 100.0f);
     reg.emplace<SDL_Color>(id) = {0xff, 0x00, 0x00, 0xff};
 
     change_box_zoom(sched, ctx, reg, id);
@@ -375,6 +407,9 @@ auto dialogue(async_io &io, dialogue_builder &dlg) -> fire_and_forget
 {
     auto start = SDL_GetTicks();
 
+    // the dialogue builds SDL_ttf text and reads the keyboard, so it stays on the main thread
+    co_await dlg.sched->stages[stage_id::update].on_main_thread();
+
     // just to showcase async I/O, load the font here
     dlg.font = co_await load_font(io, "assets/fonts/Exo_2/static/Exo2-Regular.ttf", 24.0f);
 
@@ -439,6 +474,9 @@ auto dialogue(async_io &io, dialogue_builder &dlg) -> fire_and_forget
 // Opens a window dialog for picking a file of choice
 auto window_dialog_demo(scheduler &sched, SDL_Window *win) -> fire_and_forget
 {
+    // both the keyboard state and the dialogs need the main thread
+    co_await sched.stages[stage_id::update].on_main_thread();
+
     auto kb = SDL_GetKeyboardState(nullptr);
     // wait until D is pressed
     while (!kb[SDL_SCANCODE_D])
@@ -464,18 +502,120 @@ auto window_dialog_demo(scheduler &sched, SDL_Window *win) -> fire_and_forget
         printf("You selected %.*s\n", (int)result.files[0].size(), result.files[0].data());
 }
 
-auto imgui_widgets(scheduler &sched, context &ctx) -> fire_and_forget
+// demo: a long computation sliced across frames, using only the time the frame doesn't need
+auto count_primes(scheduler &sched, Uint32 limit) -> fire_and_forget
+{
+    auto &&bg = sched.background[background_stage];
+    co_await bg.sched(priority::low);
+
+    Uint32 count = 0;
+    for (Uint32 n = 2; n < limit; ++n)
+    {
+        auto prime = true;
+        for (Uint32 d = 2; d * d <= n && prime; ++d)
+            prime = n % d != 0;
+
+        count += prime;
+
+        // give the rest of the frame back every now and then
+        if (n % 1000 == 0)
+            co_await bg.sched(priority::low);
+    }
+
+    std::printf("Found %u primes below %u\n", count, limit);
+}
+
+// stress: types `what` out letter by letter, over and over, like `dialogue_builder::say` does, until the game loop stops
+auto stress_line(scheduler &sched, entt::registry &reg, TTF_TextEngine *eng, std::shared_ptr<TTF_Font> font, SDL_FPoint at, std::string_view what) -> fire_and_forget
+{
+    auto &&update = sched.stages[stage_id::update];
+    auto const stop = sched.stop.get_token();
+
+    // SDL_ttf stays on the main thread
+    co_await update.on_main_thread();
+
+    auto text = TTF_CreateText(eng, font.get(), nullptr, 0);
+
+    // entities are only created on the render stage, see `main`
+    co_await sched.stages[stage_id::render].sched();
+
+    auto const id = reg.create();
+    reg.emplace<SDL_FPoint>(id, at);
+    reg.emplace<text_data>(id, text);
+    reg.emplace<dialogue_text_tag>(id);
+
+    // the sleeps end early once the game loop stops
+    while (!stop.stop_requested())
+    {
+        for (std::size_t i{}; i < what.size() && co_await update.sleep(40, stop); ++i)
+            TTF_AppendTextString(text, what.data() + i, 1);
+
+        if (co_await update.sleep(1000, stop))
+            TTF_SetTextString(text, nullptr, 0);
+    }
+
+    // nothing draws the text anymore during cleanup; the font goes with the last line
+    co_await sched.stages[stage_id::cleanup].sched();
+    reg.destroy(id);
+    TTF_DestroyText(text);
+}
+
+// stress: `n` of every kind of entity of the demo, laid out on a grid over the window
+auto stress_scene(async_io &io, scheduler &sched, context &ctx, entt::registry &reg, box_color_events &colors, TTF_TextEngine *eng, std::size_t n) -> fire_and_forget
+{
+    auto const cols = std::max<std::size_t>(std::size_t(SDL_ceil(SDL_sqrt(double(n)))), 1);
+    auto cell = [&](std::size_t i, SDL_FPoint origin, SDL_FPoint size)
+    {
+        return SDL_FPoint{
+            origin.x + size.x * float(i % cols) / float(cols),
+            origin.y + size.y * float(i / cols) / float(cols),
+        };
+    };
+
+    for (std::size_t i{}; i < n; ++i)
+    {
+        auto const at = cell(i, {150.0f, 150.0f}, {1000.0f, 450.0f});
+        spawn_player(sched, ctx, reg, {at.x, at.y});
+        spawn_color_box(sched, reg, colors, cell(i, {0.0f, 0.0f}, {1180.0f, 620.0f}));
+        spawn_zoom_box(sched, ctx, reg, cell(i, {50.0f, 50.0f}, {1180.0f, 620.0f}));
+    }
+
+    co_await sched.stages[stage_id::update].on_main_thread();
+
+    auto fnt = co_await load_font(io, "assets/fonts/Exo_2/static/Exo2-Regular.ttf", 16.0f);
+    if (!fnt)
+        co_return;
+
+    // closed once every line is done with it
+    std::shared_ptr<TTF_Font> const font{fnt, TTF_CloseFont};
+    for (std::size_t i{}; i < n; ++i)
+        stress_line(sched, reg, eng, font, cell(i, {0.0f, 0.0f}, {1180.0f, 700.0f}), "The quick brown fox jumps over the lazy dog.");
+}
+
+auto imgui_widgets(scheduler &sched, context &ctx, trace_stats &suspend_points) -> fire_and_forget
 {
     while (true)
     {
         co_await sched.stages[imgui_stage].sched();
 
         coroutine_profiler(ctx.traces);
+        suspend_point_stats(suspend_points);
+        frame_allocator_stats(sched.frames);
+        frame_usage_stats(frame_usage::global());
+        background_budgets(ctx.budgets);
     }
 }
 
-int main(int, char **)
+int main(int argc, char **argv)
 {
+    demo_options opts;
+    if (!parse_options(argc, argv, opts))
+        return -1;
+
+    // NOTE: no display or GPU on CI boxes; fall back to the dummy driver if SDL was built without the offscreen one
+    if (opts.headless)
+        SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen,dummy");
+
     auto init_sdl = SDL_Init(SDL_INIT_VIDEO);
     ENSURE(init_sdl, "Couldn't init SDL3");
 
@@ -483,7 +623,7 @@ int main(int, char **)
     auto win = SDL_CreateWindow("Modern C++ game example", 1280, 720, win_flags);
     ENSURE(win, "Couldn't create window");
 
-    auto ren = SDL_CreateRenderer(win, nullptr);
+    auto ren = SDL_CreateRenderer(win, opts.headless ? SDL_SOFTWARE_RENDERER : nullptr);
     ENSURE(ren, "Couldn't create renderer");
 
     auto init_ttf = TTF_Init();
@@ -494,11 +634,26 @@ int main(int, char **)
 
     entt::registry reg;
 
+    // NOTE: create the component pools up front; coroutines on workers then only look them up.
+    // Workers only read and write the values of existing components: entities are created and destroyed either before the game loop,
+    // or by coroutines on the render stage, which runs on the main thread once the update workers are done (eg. `dialogue_builder::say`)
+    reg.storage<pos>();
+    reg.storage<speed>();
+    reg.storage<SDL_Color>();
+    reg.storage<SDL_FRect>();
+    reg.storage<SDL_FPoint>();
+    reg.storage<text_data>();
+    reg.storage<dialogue_text_tag>();
+
     // declare the scheduler + context
     scheduler sched;
     context ctx;
 
+    if (opts.trace_mib)
+        ctx.traces.set_capacity(opts.trace_mib * 1024 * 1024);
+
     async_io io;
+    io.set_max_in_flight(sched.stages[stage_id::update], 64); // loads starting all at once (eg. `--stress`) queue up here rather than in SDL
 
     dialogue_builder dlg{
         .sched = &sched,
@@ -508,9 +663,39 @@ int main(int, char **)
         .origin = {100.0f, 250.0f},
     };
 
+    // declare how the stages of a frame depend on each other; stages that don't depend on each other can overlap
+    // update -> imgui --------------------------------> imgui_render
+    //        \-> flush -> events -> render ----------/
+    sched.frame_stage(stage_id::update, stage_thread::main); // SDL input + ImGui frame start
+    sched.frame_stage(stage_id::render, stage_thread::main); // SDL renderer
+    sched.frame_stage(imgui_stage, stage_thread::main); // ImGui widgets
+    sched.frame_stage(imgui_render_stage, stage_thread::main);
+    sched.frame_stage(flush_stage, stage_thread::any); // thread-safe, so it can overlap with imgui on a worker
+    sched.frame_stage(events_stage, stage_thread::main); // writes the registry
+
+    sched.run_after(imgui_stage, stage_id::update);
+    sched.run_after(flush_stage, stage_id::update);
+    sched.run_after(events_stage, flush_stage);
+    sched.run_after(stage_id::render, events_stage);
+    sched.run_after(imgui_render_stage, imgui_stage);
+    sched.run_after(imgui_render_stage, stage_id::render);
+
+    // game logic that doesn't touch SDL runs on every core; the rest pins itself with `on_main_thread()`
+    thread_pool workers;
+    sched.stages[stage_id::update].set_workers(&workers);
+
+    // background work gets what is left of a 60 FPS frame unless paced otherwise
+    auto const frame_time = SDL_NS_PER_SECOND / (opts.fps ? opts.fps : 60);
+
+    // headless runs go as fast as they can, unless given `--fps`
+    frame_pacer pacer{opts.fps ? frame_time : 0, opts.spin};
+
+    // per suspend point, updated with the new traces after every frame
+    trace_stats suspend_points;
+
     // create all the coroutines you plan to submit initially
-    imgui_system(sched, ctx, win, ren); // this handles ImGui setup + cleanup
-    imgui_widgets(sched, ctx);          // this handles the widgets
+    imgui_system(sched, win, ren); // this handles ImGui setup + cleanup
+    imgui_widgets(sched, ctx, suspend_points); // this handles the widgets
 
     render_task(sched, reg, ren);
     dialogue(io, dlg);
@@ -521,18 +706,71 @@ int main(int, char **)
         timeout(sched.stages[stage_id::update], 3500) //
     );
 
+    // color changes are published during update, then applied all at once before rendering
+    // NOTE: the flush gets its own stage, so that it comes after everything update runs; the subscribers get another one, since a stage doesn't resume what is posted to it while it runs
+    box_color_events box_colors{sched.stages[events_stage]};
+    apply_box_colors(box_colors, reg);
+
     // spawn some entities
     spawn_player(sched, ctx, reg);
-    spawn_color_box(sched, reg);
+    spawn_color_box(sched, reg, box_colors);
     spawn_zoom_box(sched, ctx, reg);
 
+    count_primes(sched, 10'000'000);
+
+    if (opts.stress)
+        stress_scene(io, sched, ctx, reg, box_colors, text_engine, opts.stress);
+
     // run the startup stage
     sched.stages[stage_id::startup].run(ctx);
 
     io.run_on(sched.stages[stage_id::update]);
+    box_colors.run_on(sched.stages[flush_stage]);
+
+    std::pair<stage_id, std::string_view> const stage_names[]{
+        {imgui_stage, "imgui"},
+        {imgui_render_stage, "imgui_render"},
+        {flush_stage, "flush"},
+        {events_stage, "events"},
+        {background_stage, "background"},
+    };
+
+    std::size_t frame_count = 0;
+    frame_stats stats;
+    for (auto &&[sid, name] : stage_names)
+        stats.name_stage(sid, name);
+    stats.param("stress", opts.stress);
+    stats.param("fps", opts.fps);
+    stats.param("spin_us", std::size_t(opts.spin / SDL_NS_PER_US));
+
+    std::optional<trace_exporter> exporter;
+    if (opts.chrome_trace)
+    {
+        exporter.emplace(opts.chrome_trace);
+        for (auto &&[sid, name] : stage_names)
+            exporter->name_stage(sid, name);
+    }
+
+    // every coroutine frame still alive, and the memory reserved for them
+    auto coroutine_frames = [&]
+    {
+        std::size_t live = 0, reserved = 0;
+        for (auto *frames : {&sched.frames, &frame_allocator::global()})
+        {
+            for (auto &&cls : frames->stats())
+            {
+                live += cls.live;
+                reserved += cls.bytes_reserved;
+            }
+        }
+
+        return std::pair{live, reserved};
+    };
 
     while (!sched.stop.stop_requested())
     {
+        pacer.frame_started();
+
         SDL_Event event;
         while (SDL_PollEvent(&event))
         {
@@ -551,24 +789,68 @@ int main(int, char **)
             }
         }
 
-        // game loop
-        sched.stages[stage_id::update].run(ctx); // first, run the "tick" coroutines (game logic)
+        // `SDL_GetMouseState` must be called on the main thread; coroutines read this copy instead
+        ctx.mouse.buttons = SDL_GetMouseState(&ctx.mouse.x, &ctx.mouse.y);
 
-        // rendering
-        {
-            SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
-            SDL_RenderClear(ren);
+        // NOTE: the frame stop is requested in still runs, so that the coroutines waiting on `sched.stop` can wrap up
+        if (opts.frames && ++frame_count >= opts.frames)
+            sched.stop.request_stop();
+
+        SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
+        SDL_RenderClear(ren);
+
+        // game loop: "tick" coroutines (game logic) first, then rendering, as declared above
+        sched.run_frame(ctx, &workers, opts.step);
+
+        // then background work, for as long as the frame can afford
+        sched.run_background(ctx, frame_time);
 
-            sched.stages[stage_id::render].run(ctx); // then run rendering coroutines
+        SDL_RenderPresent(ren);
 
-            SDL_RenderPresent(ren);
+        suspend_points.collect(ctx.traces);
+        suspend_points.add_frame(ctx.frame.wall);
+
+        if (exporter)
+            exporter->collect(ctx.traces);
+
+        if (opts.stats_path || opts.stress)
+        {
+            auto const [live, reserved] = coroutine_frames();
+            stats.record(ctx, live, reserved, pacer.last_interval());
         }
 
-        SDL_Delay(1);
+        // sleep until the next frame, a sleeping coroutine or an event, whichever is first
+        if (opts.fps)
+            pacer.wait(sched);
+        else if (!opts.headless)
+            SDL_Delay(1);
     }
 
+    if (opts.stress)
+        stats.print_summary(stdout);
+
     sched.stages[stage_id::cleanup].run(ctx); // finally run cleanup-related coros
 
+    if (exporter)
+    {
+        exporter->collect(ctx.traces);
+        if (auto const dropped = exporter->dropped())
+            std::printf("The trace export couldn't keep up, %llu traces were dropped\n", (unsigned long long)dropped);
+
+        exporter.reset(); // flush + close the file
+    }
+
+    if (opts.stats_path)
+    {
+        if (auto out = std::fopen(opts.stats_path, "w"))
+        {
+            stats.write(out, ctx.traces);
+            std::fclose(out);
+        }
+        else
+            std::printf("ERROR: Couldn't open %s\n", opts.stats_path);
+    }
+
     dlg.cleanup();
 
     TTF_DestroyRendererTextEngine(text_engine);
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <coroutine>
+#include <mutex>
+#include <source_location>
+
+#include <SDL3/SDL_timer.h>
+
+#include "coro/profiler.hpp"
+#include "coro/stage.hpp"
+#include "coro/timer_wheel.hpp"
+
+#include "utils/spin_lock.hpp"
+
+// Stage for background work (eg. asset decoding, pathfinding, saving) that only gets the time left over in a frame.
+// Coroutines are resumed by priority, oldest first within each priority, until the budget of the run is spent; whatever is left waits for the next run at the front of its queue.
+// NOTE: at least one coroutine is resumed per run, so the backlog keeps moving even when the frame is already over budget
+// NOTE: a single resume is never interrupted, so keep the slices of work short
+// NOTE: everything is resumed on the thread calling `run_into`; coroutines keep their pin for the other stages they go to
+struct budgeted_stage final
+{
+    static constexpr std::size_t priority_count = std::size_t(priority::_count);
+
+    budgeted_stage() = default;
+
+    budgeted_stage(budgeted_stage const &) = delete;
+    budgeted_stage &operator=(budgeted_stage const &) = delete;
+
+    budgeted_stage(budgeted_stage &&) = default;
+    budgeted_stage &operator=(budgeted_stage &&) = default;
+
+    // Resume queued coroutines for at most `budget` ns (see the notes above), tracing them into `out`; the sleepers due by `now` (ns) go first
+    inline budget_report run_into(Uint64 now, Uint64 budget, std::vector<trace> &out);
+
+    // Schedule the coroutine of `t` for the next time this stage runs; see `stage_info::schedule` for the lifetime of `t`
+    inline void schedule(coro_state &t, priority p = priority::normal)
+    {
+        stage_info::stamp_wait(t);
+
+        std::scoped_lock lk{lock};
+        ready[std::size_t(p)].push_one(t);
+    }
+
+    // Schedule the coroutine of `s` to be queued after `ms` time
+    inline void schedule_after(sleeper &s, Uint64 ms, priority p = priority::normal)
+    {
+        if constexpr (tracing::policy != trace_policy::off)
+            s.state.wait_start = SDL_GetTicksNS();
+
+        std::scoped_lock lk{lock};
+        s.when = SDL_NS_TO_MS(time) + ms;
+        waiting[std::size_t(p)].insert(s);
+    }
+
+    // Take `s` off the timer without scheduling it; see `stage_info::forget`
+    inline bool forget(sleeper &s, priority p)
+    {
+        std::scoped_lock lk{lock};
+        return waiting[std::size_t(p)].remove(s);
+    }
+
+    // When the earliest sleeper of this stage is due (ns), or `timer_wheel::never`; see `stage_info::next_due`
+    [[nodiscard]]
+    inline Uint64 next_due()
+    {
+        std::scoped_lock lk{lock};
+
+        auto due = timer_wheel::never;
+        for (auto &&w : waiting)
+            due = std::min(due, w.next_due());
+
+        return due == timer_wheel::never ? due : SDL_MS_TO_NS(due);
+    }
+
+    // Schedule the coroutine for the next time this stage runs
+    struct sched_awaiter;
+    inline sched_awaiter sched(priority p = priority::normal) noexcept;
+
+    // Schedule the coroutine to be queued after `ms` time
+    struct sleep_awaiter;
+    inline sleep_awaiter sleep(Uint64 ms, priority p = priority::normal) noexcept;
+
+private:
+    Uint64 time = SDL_GetTicksNS();
+
+    // v-- guarded by `lock`, since coroutines running on workers can schedule into any stage
+    spin_lock lock;
+    std::array<coro_list, priority_count> ready;
+    static_assert(priority_count == 3);
+    std::array<timer_wheel, priority_count> waiting{
+        timer_wheel{SDL_NS_TO_MS(time)},
+        timer_wheel{SDL_NS_TO_MS(time)},
+        timer_wheel{SDL_NS_TO_MS(time)},
+    }; // ticks are in ms
+};
+
+inline budget_report budgeted_stage::run_into(Uint64 now, Uint64 budget, std::vector<trace> &out)
+{
+    time = now;
+
+    // sleepers that are due join the back of their queue
+    std::size_t sleeping = 0;
+    {
+        std::scoped_lock lk{lock};
+        for (std::size_t p{}; p < priority_count; ++p)
+        {
+            timer_list due;
+            waiting[p].advance(SDL_NS_TO_MS(time), due);
+
+            while (auto node = due.pop())
+            {
+                auto &&s = static_cast<sleeper &>(*node);
+                s.state.wait_finish = SDL_MS_TO_NS(s.when);
+                ready[p].push_one(s.state);
+            }
+            sleeping += waiting[p].size();
+        }
+    }
+
+    auto const begin = SDL_GetTicksNS();
+    auto last = begin; // when the last resume finished
+    std::size_t resumed = 0;
+
+    // coroutines that schedule themselves again run again in the same run, as long as there's budget left
+    while (resumed == 0 || last - begin < budget)
+    {
+        coro_state *t;
+        {
+            std::scoped_lock lk{lock};
+            auto const it = std::find_if(ready.begin(), ready.end(), [](coro_list const &q)
+                                         { return !q.is_empty(); });
+            if (it == ready.end())
+                break;
+
+            t = it->pop();
+        }
+
+        stage_info::run_one(*t, out);
+        last = SDL_GetTicksNS();
+        ++resumed;
+    }
+
+    budget_report report{
+        .budget = budget,
+        .used = last - begin,
+        .resumed = resumed,
+        .sleeping = sleeping,
+    };
+
+    std::scoped_lock lk{lock};
+    for (std::size_t p{}; p < priority_count; ++p)
+        report.backlog[p] = ready[p].size;
+
+    return report;
+}
+
+struct [[nodiscard]] budgeted_stage::sched_awaiter final
+{
+    budgeted_stage *s;
+    priority p;
+    coro_state state;
+
+    static constexpr bool await_ready() noexcept { return false; }
+
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd,
+                              std::source_location const &sl = std::source_location::current()) noexcept
+    {
+        state = coro_state::of(hnd, sl, stage_info::current_thread());
+        s->schedule(state, p);
+        return stage_info::transfer(hnd);
+    }
+
+    static constexpr void await_resume() noexcept {}
+};
+inline auto budgeted_stage::sched(priority p) noexcept -> budgeted_stage::sched_awaiter { return sched_awaiter{this, p}; }
+
+struct [[nodiscard]] budgeted_stage::sleep_awaiter final
+{
+    budgeted_stage *s;
+    Uint64 ms;
+    priority p;
+    sleeper node;
+    bool sleeping = false; // see `stage_info::sleep_awaiter`
+
+    inline ~sleep_awaiter()
+    {
+        if (sleeping)
+            s->forget(node, p);
+    }
+
+    static constexpr bool await_ready() noexcept { return false; }
+
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd,
+                              std::source_location const &sl = std::source_location::current()) noexcept
+    {
+        node.state = coro_state::of(hnd, sl, stage_info::current_thread());
+        sleeping = true;
+        s->schedule_after(node, ms, p);
+        return stage_info::transfer(hnd);
+    }
+
+    inline void await_resume() noexcept { sleeping = false; }
+};
+inline auto budgeted_stage::sleep(Uint64 ms, priority p) noexcept -> budgeted_stage::sleep_awaiter { return sleep_awaiter{this, ms, p}; }
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "coro/stage.hpp"
+#include "utils/intrusive_list.hpp"
+#include "utils/spin_lock.hpp"
+
+// Bounded FIFO of values between coroutines, eg. streaming decoded assets or gameplay messages from producers to consumers.
+// `co_await ch.send(v)` suspends while the channel is full, `co_await ch.recv()` / `co_await ch.recv_many(out)` while it is empty;
+// the coroutines they wake up are scheduled on the stage given at construction.
+// Values are moved, never copied; the ring is allocated once, and the waiting coroutines link themselves through their awaiters, so nothing is allocated per message.
+// With a capacity of 0, every `send` waits for a `recv` to take its value (rendezvous).
+// NOTE: thread-safe; the channel must outlive every coroutine waiting on it
+template <typename T>
+struct channel final
+{
+    struct send_awaiter;
+    struct recv_awaiter;
+    struct recv_many_awaiter;
+
+    inline channel(stage_info &s, std::size_t capacity)
+        : s{&s}, ring(capacity) {}
+
+    channel(channel const &) = delete;
+    channel &operator=(channel const &) = delete;
+
+    // Send `val` once there is room; `co_await` gives `false` if the channel was closed before it could
+    [[nodiscard("Must be `co_await`")]]
+    inline send_awaiter send(T val) noexcept(std::is_nothrow_move_constructible_v<T>);
+
+    // Take the oldest value, once there is one; `co_await` gives `std::nullopt` once the channel is closed and empty
+    [[nodiscard("Must be `co_await`")]]
+    inline recv_awaiter recv() noexcept;
+
+    // Take as many values as there are, up to `out.size()`, once there is at least one; `co_await` gives how many, `0` once the channel is closed and empty.
+    // NOTE: `out` must not be empty
+    [[nodiscard("Must be `co_await`")]]
+    inline recv_many_awaiter recv_many(std::span<T> out) noexcept;
+
+    // Wake every waiting coroutine: senders give up (`false`), receivers take what is left then stop (`std::nullopt` / `0`).
+    // Sending after that fails right away.
+    inline void close();
+
+    [[nodiscard]]
+    inline std::size_t capacity() const noexcept { return ring.size(); }
+
+private:
+    // what a waiting coroutine leaves in the channel; `value` is what it sends, or where it receives
+    struct waiter final
+    {
+        coro_state state;
+        std::optional<T> value;
+        waiter *next = nullptr; // see `intrusive_list`
+    };
+
+    // NOTE: the functions below must be called while holding `lock`
+
+    // Move `val` to a waiting receiver or into the ring; returns `false` if it has to wait.
+    // `val` stays engaged if the channel is closed.
+    inline bool try_send(std::optional<T> &val);
+
+    // Move the oldest value into `val`, letting a waiting sender in; returns `false` if it has to wait.
+    // `val` stays empty if the channel is closed and empty.
+    inline bool try_recv(std::optional<T> &val);
+
+    // Move the oldest value out, letting a waiting sender in.
+    // NOTE: only if there is one, ie. the ring or `senders` isn't empty
+    inline T take();
+
+    inline void wake(waiter &w)
+    {
+        w.state.woken_by(current_coro, flow_kind::event);
+        s->schedule(w.state);
+    }
+
+    stage_info *s;
+
+    // v-- guarded by `lock`, since coroutines running on workers can use the channel
+    spin_lock lock;
+    std::vector<std::optional<T>> ring;
+    std::size_t first = 0, count = 0; // the oldest value and how many follow it, wrapping around `ring`
+    intrusive_list<waiter> senders;   // only while the ring is full
+    intrusive_list<waiter> receivers; // only while the ring is empty
+    bool closed = false;
+};
+
+template <typename T>
+inline bool channel<T>::try_send(std::optional<T> &val)
+{
+    if (closed)
+        return true;
+
+    if (auto r = receivers.pop())
+    {
+        r->value = std::move(*val);
+        val.reset();
+        wake(*r);
+        return true;
+    }
+
+    if (count == ring.size())
+        return false;
+
+    ring[(first + count++) % ring.size()] = std::move(*val);
+    val.reset();
+    return true;
+}
+
+template <typename T>
+inline bool channel<T>::try_recv(std::optional<T> &val)
+{
+    if (count == 0 && senders.size == 0)
+        return closed;
+
+    val.emplace(take());
+    return true;
+}
+
+template <typename T>
+inline T channel<T>::take()
+{
+    auto sender = senders.pop();
+
+    // nothing in the ring but a sender: capacity is 0
+    if (count == 0)
+    {
+        T val = std::move(*sender->value);
+        sender->value.reset();
+        wake(*sender);
+        return val;
+    }
+
+    T val = std::move(*ring[first]);
+    ring[first].reset();
+    first = (first + 1) % ring.size();
+
+    // the ring was full: the oldest sender takes the spot that was freed
+    if (sender)
+    {
+        ring[(first + count - 1) % ring.size()] = std::move(sender->value);
+        sender->value.reset();
+        wake(*sender);
+    }
+    else
+        --count;
+
+    return val;
+}
+
+template <typename T>
+inline void channel<T>::close()
+{
+    std::scoped_lock lk{lock};
+    closed = true;
+
+    while (auto r = receivers.pop())
+        wake(*r);
+    while (auto snd = senders.pop())
+        wake(*snd);
+}
+
+template <typename T>
+struct [[nodiscard]] channel<T>::send_awaiter final
+{
+    channel *ch;
+    waiter node;
+
+    inline bool await_ready()
+    {
+        std::scoped_lock lk{ch->lock};
+        return ch->try_send(node.value);
+    }
+
+    template <typename P>
+    inline std::coroutine_handle<> await_suspend(std::coroutine_handle<P> hnd, std::source_location const &sl = std::source_location::current())
+    {
+        node.state = coro_state::of(hnd, sl, stage_info::current_thread());
+        {
+            std::scoped_lock lk{ch->lock};
+
+            // a receiver came in since `await_ready`
+            if (ch->try_send(node.value))
+                return hnd;
+
+            ch->senders.push_one(node);
+        }
+
+        return stage_info::transfer(hnd);
+    }
+
+    // whether the value was sent; it is taken as soon as it is
+    inline bool await_resume() const noexcept { return !node.value; }
+};
+
+template <typename T>
+struct [[nodiscard]] channel<T>::recv_awaiter final
+{
+    channel *ch;
+    waiter node;
+
+    inline bool await_ready()
+    {
+        std::scoped_lock lk{ch->lock};
+        return ch->try_recv(node.value);
+    }
+
+    template <typename P>
+    inline std::coroutine_handle<> await_suspend(std::coroutine_handle<P> hnd, std::source_location const &sl = std::source_location::current())
+    {
+        node.state = coro_state::of(hnd, sl, stage_info::current_thread());
+        {
+            std::scoped_lock lk{ch->lock};
+
+            // a sender came in since `await_ready`
+            if (ch->try_recv(node.value))
+                return hnd;
+
+            ch->receivers.push_one(node);
+        }
+
+        return stage_info::transfer(hnd);
+    }
+
+    inline std::optional<T> await_resume() noexcept { return std::move(node.value); }
+};
+
+template <typename T>
+struct [[nodiscard]] channel<T>::recv_many_awaiter final
+{
+    channel *ch;
+    std::span<T> out;
+    waiter node; // the first value, the others are only taken on resume
+
+    inline bool await_ready()
+    {
+        std::scoped_lock lk{ch->lock};
+        return ch->try_recv(node.value);
+    }
+
+    template <typename P>
+    inline std::coroutine_handle<> await_suspend(std::coroutine_handle<P> hnd, std::source_location const &sl = std::source_location::current())
+    {
+        node.state = coro_state::of(hnd, sl, stage_info::current_thread());
+        {
+            std::scoped_lock lk{ch->lock};
+
+            if (ch->try_recv(node.value))
+                return hnd;
+
+            ch->receivers.push_one(node);
+        }
+
+        return stage_info::transfer(hnd);
+    }
+
+    inline std::size_t await_resume()
+    {
+        if (!node.value)
+            return 0;
+
+        out[0] = std::move(*node.value);
+        std::size_t n = 1;
+
+        // whatever came in while the coroutine was waiting to resume
+        std::scoped_lock lk{ch->lock};
+        for (; n < out.size() && ch->count + ch->senders.size != 0; ++n)
+            out[n] = ch->take();
+
+        return n;
+    }
+};
+
+template <typename T>
+inline auto channel<T>::send(T val) noexcept(std::is_nothrow_move_constructible_v<T>) -> send_awaiter
+{
+    return send_awaiter{this, {.value = std::move(val)}};
+}
+
+template <typename T>
+inline auto channel<T>::recv() noexcept -> recv_awaiter { return recv_awaiter{this}; }
+
+template <typename T>
+inline auto channel<T>::recv_many(std::span<T> out) noexcept -> recv_many_awaiter { return recv_many_awaiter{this, out}; }
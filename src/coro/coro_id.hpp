@@ -0,0 +1,38 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+
+// Identity of a coroutine in the traces: the address of its frame, the same for as long as the coroutine lives; 0 is none.
+// NOTE: frames are pooled (see `frame_allocator`), so a new coroutine can get the id of one that finished
+using coro_id = std::uintptr_t;
+
+inline coro_id id_of(std::coroutine_handle<> hnd) noexcept
+{
+    return reinterpret_cast<coro_id>(hnd.address());
+}
+
+struct coro_id_hash final
+{
+    // frames are aligned, so the low bits are always 0
+    inline std::size_t operator()(coro_id id) const noexcept
+    {
+        return std::size_t(id >> 4) * 0x9e3779b97f4a7c15ull;
+    }
+};
+
+// The coroutine running on this thread, or 0 outside of them.
+// Kept up to date by the stages when they resume one, by `task` when it is awaited and when it returns, and by `fire_and_forget` when it starts.
+// NOTE: when a coroutine started from another one suspends, this goes back to the one the stage resumed rather than to the one that started it
+inline thread_local coro_id current_coro = 0;
+
+// The coroutine that started `hnd`: the one awaiting it for a `task`, the one spawning it for a `fire_and_forget`; 0 for the others
+template <typename P>
+inline coro_id parent_of(std::coroutine_handle<P> hnd) noexcept
+{
+    if constexpr (requires { hnd.promise().parent; })
+        return hnd.promise().parent;
+    else
+        return 0;
+}
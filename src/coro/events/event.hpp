@@ -2,12 +2,16 @@
 #pragma once
 
 #include <optional>
+#include <utility>
 #include "coro/stage.hpp"
 #include "utils/compressed_pair.hpp"
 
 template <typename T>
 struct event_awaiter;
 
+// Wakes every coroutine waiting on it, on the stage given at construction.
+// NOTE: `trigger` is lock-free and can be called from any thread (eg. workers, SDL callbacks); the waiters are moved to the stage in one go, see `stage_info::post`.
+// Triggering with a value from several threads at once races on the value, so only do that without one.
 template <typename T = void>
 struct event final
 {
@@ -32,41 +36,37 @@ struct event final
 private:
     inline void trigger_impl()
     {
-        auto awt = first_and_value.left;
-        while (awt)
-        {
-            s->schedule(awt->hnd, awt->suspend_point);
-            awt = awt->next;
-        }
-        first_and_value.left = awt;
+        auto const waiting = first_and_value.left.take_all();
+        for (auto state = waiting; state; state = state->next)
+            state->woken_by(current_coro, flow_kind::event);
+
+        s->post(waiting);
     }
 
     using value_type = std::conditional_t<std::is_void_v<T>, void, std::optional<T>>;
 
     stage_info *s;
-    compressed_pair<event_awaiter<T> *, value_type> first_and_value{
-        .left = nullptr,
+    compressed_pair<coro_stack, value_type> first_and_value{
+        .left = {},
     };
 
-    friend event_awaiter;
+    friend struct event_awaiter<T>;
 };
 
 template <typename T>
 struct event_awaiter final
 {
     event<T> *e;
-    std::coroutine_handle<> hnd;
-    std::source_location suspend_point;
-    event_awaiter *next = nullptr;
+    coro_state state;
 
     static constexpr bool await_ready() noexcept { return false; }
 
-    constexpr void await_suspend(std::coroutine_handle<> hnd, std::source_location const &sl = std::source_location::current()) noexcept
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd, std::source_location const &sl = std::source_location::current()) noexcept
     {
-        this->hnd = hnd;
-        suspend_point = sl;
-        next = e->first_and_value.left;
-        e->first_and_value.left = this;
+        state = coro_state::of(hnd, sl, stage_info::current_thread());
+        e->first_and_value.left.push_one(state);
+        return stage_info::transfer(hnd);
     }
 
     constexpr decltype(auto) await_resume() const noexcept
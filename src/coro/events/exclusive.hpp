@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <optional>
 #include "coro/stage.hpp"
 #include "utils/compressed_pair.hpp"
@@ -9,6 +10,8 @@
 template <typename T>
 struct exclusive_event_awaiter;
 
+// Wakes the one coroutine waiting on it, on the stage given at construction.
+// NOTE: `trigger` is lock-free and can be called from any thread, see `event`
 template <typename T = void>
 struct exclusive_event final
 {
@@ -33,30 +36,39 @@ struct exclusive_event final
 private:
     inline void trigger_impl()
     {
-        auto state = std::exchange(cont_and_value.left, coro_state{nullptr});
-        s->schedule(state.hnd, state.suspend_point);
+        auto state = cont_and_value.left.exchange(nullptr, std::memory_order_acq_rel);
+        if (state)
+        {
+            state->woken_by(current_coro, flow_kind::event);
+            state->next = nullptr;
+            s->post(state);
+        }
     }
 
     using value_type = std::conditional_t<std::is_void_v<T>, void, std::optional<T>>;
 
     stage_info *s;
-    compressed_pair<coro_state, value_type> cont_and_value{
+    compressed_pair<std::atomic<coro_state *>, value_type> cont_and_value{
         .left = nullptr,
     };
 
-    friend exclusive_event_awaiter;
+    friend struct exclusive_event_awaiter<T>;
 };
 
 template <typename T>
 struct exclusive_event_awaiter final
 {
     exclusive_event<T> *e;
+    coro_state state;
 
     static constexpr bool await_ready() noexcept { return false; }
 
-    constexpr void await_suspend(std::coroutine_handle<> hnd, std::source_location const &sl = std::source_location::current()) noexcept
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd, std::source_location const &sl = std::source_location::current()) noexcept
     {
-        e->cont_and_value.left = {hnd, sl};
+        state = coro_state::of(hnd, sl, stage_info::current_thread());
+        e->cont_and_value.left.store(&state, std::memory_order_release);
+        return stage_info::transfer(hnd);
     }
 
     constexpr decltype(auto) await_resume() const noexcept
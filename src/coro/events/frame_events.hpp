@@ -0,0 +1,146 @@
+#pragma once
+
+#include <mutex>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <entt/container/dense_map.hpp>
+
+#include "coro/fire_and_forget.hpp"
+#include "coro/stage.hpp"
+#include "utils/spin_lock.hpp"
+
+template <typename T, typename KeyOf>
+struct frame_events_awaiter;
+
+namespace detail
+{
+    // where each key is in the pending events of a `frame_events`; nothing without a `KeyOf`
+    template <typename T, typename KeyOf>
+    struct frame_event_keys final
+    {
+        using type = entt::dense_map<std::remove_cvref_t<std::invoke_result_t<KeyOf, T const &>>, std::size_t>;
+    };
+
+    template <typename T>
+    struct frame_event_keys<T, void> final
+    {
+        struct type final
+        {
+        };
+    };
+}
+
+// Events of one type gathered over a frame and handed out at once: `publish` appends to a contiguous buffer,
+// `flush` wakes every subscriber once, on the stage given at construction, with a span of everything published since the last flush.
+// N events make one wake-up per subscriber instead of N.
+// With a `KeyOf` (eg. the entity an event is about), an event replaces the one with the same key published earlier in the frame, keeping its place.
+// NOTE: `publish` is thread-safe; `flush` must not run at the same time as the subscribers, which can read the span until the next `flush`
+template <typename T, typename KeyOf = void>
+struct frame_events final
+{
+    inline explicit frame_events(stage_info &s) : s{&s} {}
+
+    frame_events(frame_events const &) = delete;
+    frame_events &operator=(frame_events const &) = delete;
+
+    // Add `val` to the events of this frame
+    inline void publish(T val);
+
+    // Hand what was published since the last call to every subscriber; nothing happens if nothing was published
+    inline void flush();
+
+    // Call `flush` every time `stage` runs
+    inline fire_and_forget run_on(stage_info &stage);
+
+    // `co_await` gives a `std::span<T const>` of the events of the next `flush` that has any
+    [[nodiscard("Must be `co_await`")]]
+    inline frame_events_awaiter<T, KeyOf> operator co_await() noexcept;
+
+private:
+    stage_info *s;
+    coro_stack subscribers;
+
+    // v-- guarded by `lock`, since coroutines running on workers can publish
+    spin_lock lock;
+    std::vector<T> pending;
+    [[no_unique_address]] typename detail::frame_event_keys<T, KeyOf>::type index_of;
+
+    std::vector<T> published; // what the subscribers read; both buffers keep their memory across frames
+
+    friend struct frame_events_awaiter<T, KeyOf>;
+};
+
+template <typename T, typename KeyOf>
+struct frame_events_awaiter final
+{
+    frame_events<T, KeyOf> *e;
+    coro_state state;
+
+    static constexpr bool await_ready() noexcept { return false; }
+
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd, std::source_location const &sl = std::source_location::current()) noexcept
+    {
+        state = coro_state::of(hnd, sl, stage_info::current_thread());
+        e->subscribers.push_one(state);
+        return stage_info::transfer(hnd);
+    }
+
+    inline std::span<T const> await_resume() const noexcept { return e->published; }
+};
+
+template <typename T, typename KeyOf>
+inline void frame_events<T, KeyOf>::publish(T val)
+{
+    std::scoped_lock lk{lock};
+
+    if constexpr (!std::is_void_v<KeyOf>)
+    {
+        auto const [it, is_new] = index_of.try_emplace(KeyOf{}(val), pending.size());
+        if (!is_new)
+        {
+            pending[it->second] = std::move(val);
+            return;
+        }
+    }
+
+    pending.push_back(std::move(val));
+}
+
+template <typename T, typename KeyOf>
+inline void frame_events<T, KeyOf>::flush()
+{
+    {
+        std::scoped_lock lk{lock};
+        if (pending.empty())
+            return;
+
+        published.clear();
+        std::swap(published, pending);
+
+        if constexpr (!std::is_void_v<KeyOf>)
+            index_of.clear();
+    }
+
+    auto const waiting = subscribers.take_all();
+    for (auto state = waiting; state; state = state->next)
+        state->woken_by(current_coro, flow_kind::event);
+
+    s->post(waiting);
+}
+
+template <typename T, typename KeyOf>
+inline fire_and_forget frame_events<T, KeyOf>::run_on(stage_info &stage)
+{
+    while (true)
+    {
+        co_await stage.sched();
+        flush();
+    }
+}
+
+template <typename T, typename KeyOf>
+inline auto frame_events<T, KeyOf>::operator co_await() noexcept -> frame_events_awaiter<T, KeyOf> { return frame_events_awaiter<T, KeyOf>{this}; }
@@ -1,10 +1,13 @@
 
 #pragma once
 
+#include <atomic>
 #include <optional>
+#include <utility>
 #include "coro/stage.hpp"
 
 // an event type that remains permanently "triggered" if set
+// NOTE: `trigger` is lock-free and can be called from any thread, see `event`
 
 struct permanent_event_awaiter;
 
@@ -14,19 +17,18 @@ struct permanent_event final
 
     inline void trigger()
     {
-        set = true;
-
-        auto awt = first;
-        while (awt)
-        {
-            s->schedule(awt->hnd, awt->suspend_point);
-            awt = awt->next;
-        }
-        first = awt;
+        set.store(true, std::memory_order_release);
+
+        // NOTE: awaiters check `set` again once they are in, so none of them is left behind
+        auto const waiting = first.take_all();
+        for (auto state = waiting; state; state = state->next)
+            state->woken_by(current_coro, flow_kind::event);
+
+        s->post(waiting);
     }
 
     // sync API
-    constexpr bool has_happened() const noexcept { return set; }
+    inline bool has_happened() const noexcept { return set.load(std::memory_order_acquire); }
 
     // async API
     [[nodiscard("Must be `co_await`")]]
@@ -34,8 +36,8 @@ struct permanent_event final
 
 private:
     stage_info *s;
-    permanent_event_awaiter *first = nullptr;
-    bool set = false;
+    coro_stack first;
+    std::atomic<bool> set = false;
 
     friend permanent_event_awaiter;
 };
@@ -43,18 +45,23 @@ private:
 struct permanent_event_awaiter final
 {
     permanent_event *e;
-    std::coroutine_handle<> hnd;
-    std::source_location suspend_point;
-    permanent_event_awaiter *next = nullptr;
+    coro_state state;
 
-    constexpr bool await_ready() const noexcept { return e->set; }
+    inline bool await_ready() const noexcept { return e->has_happened(); }
 
-    constexpr void await_suspend(std::coroutine_handle<> hnd, std::source_location const &sl = std::source_location::current()) noexcept
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd, std::source_location const &sl = std::source_location::current()) noexcept
     {
-        this->hnd = hnd;
-        suspend_point = sl;
-        next = e->first;
-        e->first = this;
+        // NOTE: once pushed, a trigger on another thread can resume `hnd` and destroy this awaiter, so only locals are used after
+        auto const ev = e;
+        state = coro_state::of(hnd, sl, stage_info::current_thread());
+        ev->first.push_one(state);
+
+        // triggered in between: the trigger might have missed `state`, take it back (or whatever else is left) ourselves
+        if (ev->has_happened())
+            ev->s->post(ev->first.take_all());
+
+        return stage_info::transfer(hnd);
     }
 
     static constexpr void await_resume() noexcept {}
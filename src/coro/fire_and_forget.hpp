@@ -3,18 +3,40 @@
 
 #include <coroutine>
 #include <exception>
+#include <source_location>
+
+#include "coro/coro_id.hpp"
+#include "coro/frame_allocator.hpp"
 
 struct fire_and_forget final
 {
     struct promise_type;
 };
 
-struct fire_and_forget::promise_type final
+struct fire_and_forget::promise_type final : pooled_frame
 {
+    // NOTE: called by the compiler from the coroutine, so `sl` is the coroutine function (see `frame_usage`)
+    inline promise_type(std::source_location const &sl = std::source_location::current())
+        : pooled_frame{sl} {}
+
     static constexpr fire_and_forget get_return_object() noexcept { return {}; }
-    static constexpr std::suspend_never initial_suspend() noexcept { return {}; }
-    static constexpr std::suspend_never final_suspend() noexcept { return {}; }
+
+    // runs right away, so whatever is running now spawned it
+    inline std::suspend_never initial_suspend() noexcept
+    {
+        parent = current_coro;
+        current_coro = id_of(std::coroutine_handle<promise_type>::from_promise(*this));
+        return {};
+    }
+
+    inline std::suspend_never final_suspend() const noexcept
+    {
+        current_coro = parent;
+        return {};
+    }
 
     static constexpr void return_void() noexcept {}
     inline static void unhandled_exception() noexcept { std::terminate(); }
+
+    coro_id parent = 0; // for the traces
 };
\ No newline at end of file
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <source_location>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <entt/container/dense_map.hpp>
+#include "coro/profiler.hpp"
+#include "utils/func_name.hpp"
+#include "utils/spin_lock.hpp"
+
+// Pool allocator for coroutine frames.
+// Frames are rounded up to a power-of-two size class and carved out of big blocks; freed frames go to a per-class free list and get reused by the next coroutine of similar size.
+// Frames bigger than the biggest class fall back to the global `operator new`, but are still counted.
+// NOTE: guarded by a lock, since coroutines running on `thread_pool` workers spawn and finish frames too
+struct frame_allocator final
+{
+    static constexpr std::size_t min_slot_size = 64;
+    static constexpr std::size_t class_count = 8; // 64B, 128B, ..., 8KiB
+    static constexpr std::size_t block_size = 64 * 1024;
+
+    struct class_stats final
+    {
+        std::size_t slot_size = 0;      // bytes per frame in this class (header included); 0 for oversized frames
+        std::size_t live = 0;           // frames currently in use
+        std::size_t peak = 0;           // highest `live` ever seen
+        std::size_t allocations = 0;    // total frames handed out
+        std::size_t bytes_live = 0;     // bytes currently in use
+        std::size_t bytes_reserved = 0; // bytes taken from the system
+    };
+
+    inline frame_allocator() noexcept
+    {
+        for (std::size_t i{}; i < class_count; ++i)
+            counters[i].slot_size = min_slot_size << i;
+    }
+
+    frame_allocator(frame_allocator const &) = delete;
+    frame_allocator &operator=(frame_allocator const &) = delete;
+
+    frame_allocator(frame_allocator &&) = delete;
+    frame_allocator &operator=(frame_allocator &&) = delete;
+
+    // The allocator used by coroutines that aren't tied to any scheduler
+    inline static frame_allocator &global() noexcept
+    {
+        static frame_allocator instance;
+        return instance;
+    }
+
+    [[nodiscard]]
+    inline void *allocate(std::size_t n);
+
+    // NOTE: `p` must come from `allocate`, but it doesn't matter which allocator; the owner is stored in front of the frame
+    inline static void deallocate(void *p, std::size_t n) noexcept;
+
+    using stats_type = std::array<class_stats, class_count + 1>;
+
+    // Bytes of the slot a frame of `n` bytes takes, header included; 0 for frames too big to be pooled
+    [[nodiscard]]
+    inline static std::size_t slot_size_of(std::size_t n) noexcept
+    {
+        auto const cls = class_of(n);
+        return cls == oversized ? 0 : min_slot_size << cls;
+    }
+
+    // Copy of the counters per size class; the last entry is for frames too big to be pooled
+    [[nodiscard]]
+    inline stats_type stats() const noexcept
+    {
+        std::scoped_lock lk{lock};
+        return counters;
+    }
+
+private:
+    // NOTE: keeps the frame aligned to what the global `operator new` would give
+    struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) header final
+    {
+        frame_allocator *owner;
+        std::uint32_t size_class;
+    };
+
+    struct free_node final
+    {
+        free_node *next;
+    };
+
+    static constexpr std::uint32_t oversized = class_count;
+
+    inline static std::uint32_t class_of(std::size_t n) noexcept
+    {
+        auto const total = n + sizeof(header);
+        if (total <= min_slot_size)
+            return 0;
+
+        auto const cls = std::bit_width(total - 1) - std::bit_width(min_slot_size - 1);
+        return cls < class_count ? std::uint32_t(cls) : oversized;
+    }
+
+    inline void refill(std::uint32_t cls)
+    {
+        auto const slot_size = counters[cls].slot_size;
+        auto const base = blocks.emplace_back(new std::byte[block_size]).get();
+
+        // push in reverse so that the frames are handed out in address order
+        for (auto i = block_size / slot_size; i-- > 0;)
+            free_lists[cls] = ::new (base + i * slot_size) free_node{free_lists[cls]};
+
+        counters[cls].bytes_reserved += block_size;
+    }
+
+    mutable spin_lock lock;
+    std::array<free_node *, class_count> free_lists{};
+    stats_type counters{};
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+};
+
+inline void *frame_allocator::allocate(std::size_t n)
+{
+    auto const cls = class_of(n);
+
+    std::scoped_lock lk{lock};
+    auto &&cnt = counters[cls];
+
+    void *slot;
+    if (cls == oversized)
+    {
+        slot = ::operator new(n + sizeof(header));
+        cnt.bytes_reserved += n + sizeof(header);
+        cnt.bytes_live += n + sizeof(header);
+    }
+    else
+    {
+        if (!free_lists[cls])
+            refill(cls);
+
+        auto node = free_lists[cls];
+        free_lists[cls] = node->next;
+
+        slot = node;
+        cnt.bytes_live += cnt.slot_size;
+    }
+
+    ++cnt.allocations;
+    if (++cnt.live > cnt.peak)
+        cnt.peak = cnt.live;
+
+    auto const hdr = ::new (slot) header{this, cls};
+    return hdr + 1;
+}
+
+inline void frame_allocator::deallocate(void *p, std::size_t n) noexcept
+{
+    auto const hdr = static_cast<header *>(p) - 1;
+    auto const self = hdr->owner;
+    auto const cls = hdr->size_class;
+
+    std::scoped_lock lk{self->lock};
+    auto &&cnt = self->counters[cls];
+
+    --cnt.live;
+
+    if (cls == oversized)
+    {
+        cnt.bytes_live -= n + sizeof(header);
+        cnt.bytes_reserved -= n + sizeof(header);
+        ::operator delete(hdr);
+        return;
+    }
+
+    cnt.bytes_live -= cnt.slot_size;
+    self->free_lists[cls] = ::new (static_cast<void *>(hdr)) free_node{self->free_lists[cls]};
+}
+
+// Live coroutine frames per coroutine function, whichever allocator they come from; filled in by `pooled_frame`.
+// Meant to catch frame leaks (eg. coroutines that never finish) and frames too big for the pools.
+// NOTE: counting takes a lock on every frame created and destroyed, so it is compiled out with the traces (see `tracing::policy`) and stays empty then
+struct frame_usage final
+{
+    struct function_stats final
+    {
+        std::string_view name;      // see `trim_func_name`
+        std::size_t frame_size = 0; // bytes of one frame, the biggest one seen
+        std::size_t live = 0;       // frames currently alive
+        std::size_t peak = 0;       // highest `live` ever seen
+        std::size_t created = 0;    // total frames created
+        std::size_t bytes_live = 0; // bytes currently alive
+        std::size_t bytes_peak = 0; // highest `bytes_live` ever seen
+    };
+
+    inline static frame_usage &global() noexcept
+    {
+        static frame_usage instance;
+        return instance;
+    }
+
+    // Count a new frame of `bytes` for the coroutine function of `sl`; returns what to pass to `destroyed`
+    [[nodiscard]]
+    inline std::uint32_t created(std::source_location const &sl, std::size_t bytes);
+
+    inline void destroyed(std::uint32_t function, std::size_t bytes) noexcept
+    {
+        std::scoped_lock lk{lock};
+        auto &&f = functions[function];
+        --f.live;
+        f.bytes_live -= bytes;
+    }
+
+    // Copy of the counters, one per coroutine function in the order they first ran
+    [[nodiscard]]
+    inline std::vector<function_stats> stats() const
+    {
+        std::scoped_lock lk{lock};
+        return functions;
+    }
+
+private:
+    mutable spin_lock lock;
+    std::vector<function_stats> functions;
+    entt::dense_map<char const *, std::uint32_t> ids; // by `function_name`, which is the same pointer for the same function
+};
+
+inline std::uint32_t frame_usage::created(std::source_location const &sl, std::size_t bytes)
+{
+    std::scoped_lock lk{lock};
+
+    auto it = ids.find(sl.function_name());
+    if (it == ids.end())
+    {
+        it = ids.emplace(sl.function_name(), std::uint32_t(functions.size())).first;
+        functions.push_back({.name = trim_func_name(sl.function_name())});
+    }
+
+    auto &&f = functions[it->second];
+    f.frame_size = std::max(f.frame_size, bytes);
+    ++f.created;
+    f.peak = std::max(f.peak, ++f.live);
+    f.bytes_live += bytes;
+    f.bytes_peak = std::max(f.bytes_peak, f.bytes_live);
+
+    return it->second;
+}
+
+// Inherit from this on a promise type to allocate the coroutine frames from a `frame_allocator`.
+// If the first parameter of the coroutine has a `frames` allocator (eg. `scheduler &`) the frame comes from there, otherwise from `frame_allocator::global()`.
+// Frames are also counted per coroutine function in `frame_usage::global()`: give the promise a default constructor taking `std::source_location::current()` and pass it on,
+// the compiler calls it from the coroutine so the location is the coroutine's (see `task_promise`).
+struct pooled_frame
+{
+    inline explicit pooled_frame([[maybe_unused]] std::source_location const &sl = std::source_location::current())
+        : frame_bytes{std::exchange(last_frame_bytes, 0)}
+    {
+        if constexpr (tracing::policy != trace_policy::off)
+            function = frame_usage::global().created(sl, frame_bytes);
+    }
+
+    pooled_frame(pooled_frame const &) = delete;
+    pooled_frame &operator=(pooled_frame const &) = delete;
+
+    inline ~pooled_frame()
+    {
+        if constexpr (tracing::policy != trace_policy::off)
+            frame_usage::global().destroyed(function, frame_bytes);
+    }
+
+    inline static void *operator new(std::size_t n)
+    {
+        last_frame_bytes = n;
+        return frame_allocator::global().allocate(n);
+    }
+
+    template <typename Owner, typename... Args>
+        requires requires(Owner &o) { { o.frames } -> std::same_as<frame_allocator &>; }
+    inline static void *operator new(std::size_t n, Owner &o, Args &...)
+    {
+        last_frame_bytes = n;
+        return o.frames.allocate(n);
+    }
+
+    inline static void operator delete(void *p, std::size_t n) noexcept { frame_allocator::deallocate(p, n); }
+
+private:
+    // NOTE: the compiler constructs the promise right after allocating its frame, on the same thread
+    inline static thread_local std::size_t last_frame_bytes = 0;
+
+    std::size_t frame_bytes;
+    std::uint32_t function = 0; // see `frame_usage::created`
+};
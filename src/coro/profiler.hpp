@@ -1,9 +1,16 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <string_view>
 #include <thread>
 
+#include "coro/coro_id.hpp"
+#include "coro/suspend_sites.hpp"
+
 enum class stage_id : uint32_t
 {
     startup,
@@ -13,11 +20,130 @@ enum class stage_id : uint32_t
     _custom,
 };
 
+// Name of the stages that always exist; empty for the others
+constexpr std::string_view builtin_stage_name(stage_id sid) noexcept
+{
+    switch (sid)
+    {
+    case stage_id::startup:
+        return "startup";
+    case stage_id::update:
+        return "update";
+    case stage_id::render:
+        return "render";
+    case stage_id::cleanup:
+        return "cleanup";
+    default:
+        return {};
+    }
+}
+
+// How much the stages trace; picked at compile time with `CORO_TRACE_POLICY` (eg. `-DCORO_TRACE_POLICY=off` for release builds)
+enum class trace_policy : uint8_t
+{
+    off,     // no trace, and no clock read for them either
+    sampled, // one resume out of `tracing::sample_every`
+    full,    // every resume
+};
+
+#ifndef CORO_TRACE_POLICY
+#define CORO_TRACE_POLICY full
+#endif
+
+#ifndef CORO_TRACE_SAMPLE_EVERY
+#define CORO_TRACE_SAMPLE_EVERY 16
+#endif
+
+// The tracing policy of the build, and whether the stages record right now
+struct tracing final
+{
+    static constexpr trace_policy policy = trace_policy::CORO_TRACE_POLICY;
+    static constexpr std::uint32_t sample_every = CORO_TRACE_SAMPLE_EVERY; // in `sampled` mode, counted per thread
+
+    // Pause or resume recording at runtime, eg. from the profiler's Record button; takes effect from the next run of each stage
+    inline static void set_recording(bool on) noexcept { recording.store(on, std::memory_order_relaxed); }
+
+    // always false when tracing is compiled out
+    [[nodiscard]]
+    inline static bool is_recording() noexcept
+    {
+        if constexpr (policy == trace_policy::off)
+            return false;
+        else
+            return recording.load(std::memory_order_relaxed);
+    }
+
+private:
+    inline static std::atomic<bool> recording = true;
+};
+
+// What made a coroutine ready to run again, see `trace::waker`
+enum class flow_kind : uint8_t
+{
+    none,  // a stage or a timer: it asked to run later
+    event, // another coroutine triggered an event it was waiting on
+    io,    // something it started (eg. a file read) completed
+};
+
+constexpr std::string_view flow_name(flow_kind flow) noexcept
+{
+    switch (flow)
+    {
+    case flow_kind::event:
+        return "event";
+    case flow_kind::io:
+        return "io";
+    default:
+        return {};
+    }
+}
+
 struct trace final
 {
-    std::string_view name;
-    uint_least32_t line;
+    std::uint32_t site; // where the coroutine suspended before running, see `suspend_sites`
     stage_id stage;
     std::thread::id tid;
+
+    // all in ns, from `SDL_GetTicksNS`
+    uint64_t wait_start;  // when the coroutine was queued (or put to sleep)
+    uint64_t wait_finish; // when it could have been resumed: `wait_start`, or the deadline for sleepers
     uint64_t start, finish;
+
+    // v-- see `coro_id`; 0 when unknown
+    coro_id id;     // the coroutine that ran
+    coro_id parent; // the one that started it: awaited it as a `task`, or spawned it as a `fire_and_forget`
+    coro_id waker;  // the one that made it ready: the one that triggered the event, or itself for io
+    flow_kind flow;
+
+    [[nodiscard]]
+    inline std::string_view name() const noexcept { return suspend_sites::global()[site].name; }
+
+    [[nodiscard]]
+    inline uint_least32_t line() const noexcept { return suspend_sites::global()[site].line; }
+};
+
+// How long a stage took during one `scheduler::run_frame`
+struct stage_timing final
+{
+    stage_id stage;
+    uint64_t duration; // ns
+};
+
+// How urgent the work of a `budgeted_stage` is; higher classes always go first
+enum class priority : uint8_t
+{
+    high,
+    normal,
+    low,
+    _count,
+};
+
+// What a `budgeted_stage` did during one frame
+struct budget_report final
+{
+    stage_id stage;
+    uint64_t budget, used; // ns; `used` can go over `budget` by up to one resume
+    std::size_t resumed;
+    std::array<std::size_t, std::size_t(priority::_count)> backlog; // coroutines left queued for the next frame, per priority
+    std::size_t sleeping;
 };
@@ -1,8 +1,18 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdio>
+#include <span>
+#include <utility>
+#include <vector>
+
 #include <imgui.h>
+#include <SDL3/SDL_timer.h>
+#include "coro/frame_allocator.hpp"
 #include "coro/profiler.hpp"
+#include "coro/trace_ring.hpp"
+#include "coro/trace_stats.hpp"
 
 constexpr ImU32 color_by_tag(uint32_t tag) noexcept
 {
@@ -20,27 +30,29 @@ constexpr ImU32 color_by_tag(uint32_t tag) noexcept
     return colors[tag % std::size(colors)];
 }
 
-inline void coroutine_profiler(std::span<trace const> traces)
+// Timeline of the traces; only the part in view is drawn, so its cost doesn't grow with the history
+inline void coroutine_profiler(trace_ring const &traces)
 {
     if (ImGui::Begin("Profiler"))
     {
-        static bool record = true;
-        // if (ImGui::Button(record ? "Pause" : "Record"))
-        // {
-        //     record = !record;
-
-        //     using namespace entt::literals;
-        //     if (!record)
-        //     {
-        //         profiler::remove_sink("<imgui>"_hs);
-        //     }
-        //     else
-        //     {
-        //         profiler::add_sink("<imgui>"_hs, *this);
-        //     }
-        // }
-
-        // ImGui::SameLine();
+        if constexpr (tracing::policy == trace_policy::off)
+        {
+            ImGui::TextUnformatted("Tracing is compiled out (CORO_TRACE_POLICY=off)");
+        }
+        else
+        {
+            auto const record = tracing::is_recording();
+            if (ImGui::Button(record ? "Pause" : "Record"))
+                tracing::set_recording(!record);
+
+            if constexpr (tracing::policy == trace_policy::sampled)
+            {
+                ImGui::SameLine();
+                ImGui::Text("1 resume out of %u", tracing::sample_every);
+            }
+        }
+
+        ImGui::SameLine();
 
         static bool auto_scroll = true;
         ImGui::Checkbox("Auto scroll", &auto_scroll);
@@ -48,11 +60,12 @@ inline void coroutine_profiler(std::span<trace const> traces)
         if (ImGui::BeginChild("ProfilerChild", ImVec2(0, 300), ImGuiChildFlags_Borders, ImGuiWindowFlags_HorizontalScrollbar))
         {
             static auto time_scale = 0.1f; // pixels per microsecond
+            auto const ns_scale = time_scale / SDL_NS_PER_US;
 
-            auto const min_time = traces.size() == 0 ? 0 : traces.front().start;
-            auto const max_time = traces.size() == 0 ? 0 : traces.back().finish;
+            auto const min_time = traces.empty() ? 0 : traces[0].start;
+            auto const max_time = traces.empty() ? 0 : traces[traces.size() - 1].finish;
 
-            auto const content_width = (max_time - min_time) * time_scale;
+            auto const content_width = (max_time - min_time) * ns_scale;
             ImGui::Dummy(ImVec2(content_width, 0)); // extend scrollable width
 
             // Check if user has manually scrolled
@@ -73,32 +86,76 @@ inline void coroutine_profiler(std::span<trace const> traces)
 
             auto const y = origin.y;
             auto const row_height = 20.0f;
-            auto const max_rows = 100;
+            auto const min_width = 1.0f; // pixels; anything narrower is merged with its neighbours
 
-            std::vector<int> stack;
+            // only look at the traces in view; the one before the first can still reach into it
+            auto const view_min = ImGui::GetWindowPos().x;
+            auto const view_max = view_min + ImGui::GetWindowWidth();
+            auto const time_at = [&](float x)
+            {
+                return min_time + Uint64(std::max(0.0f, x - origin.x) / ns_scale);
+            };
+
+            auto first = traces.lower_bound(time_at(view_min));
+            auto const last = traces.lower_bound(time_at(view_max) + 1);
+            if (first != 0)
+                --first;
+
+            // sub-pixel traces next to each other are drawn as one block
+            struct
+            {
+                float x_start = 0, x_end = 0;
+                Uint64 start = 0, finish = 0;
+                std::size_t count = 0;
+            } merged;
 
-            // TODO: rather stack by task id
-            for (int i{}; const auto &e : traces)
+            auto const draw_merged = [&]
             {
-                while (!stack.empty())
+                if (merged.count == 0)
+                    return;
+
+                ImVec2 const p0(merged.x_start, y);
+                ImVec2 const p1(std::max(merged.x_end, merged.x_start + min_width), y + row_height - 2);
+                draw_list->AddRectFilled(p0, p1, IM_COL32(160, 160, 160, 255));
+
+                if (ImGui::IsMouseHoveringRect(p0, p1))
                 {
-                    auto parent = stack.back();
-                    if (e.start >= traces[parent].finish)
+                    if (ImGui::BeginTooltip())
                     {
-                        stack.pop_back();
+                        ImGui::Text("%zu coroutines, zoom in to see them", merged.count);
+                        ImGui::Text("Time: %.3f ms", double(merged.start) / SDL_NS_PER_MS);
+                        ImGui::Text("Span: %.3f us", double(merged.finish - merged.start) / SDL_NS_PER_US);
+                        ImGui::EndTooltip();
                     }
-                    else
+                }
+
+                merged.count = 0;
+            };
+
+            traces.for_each(first, last, [&](trace const &e)
+            {
+                auto const depth = 0; // TODO: enable the hierarchy back eventually
+
+                auto const x_start = origin.x + (e.start - min_time) * ns_scale;
+                auto const x_end = x_start + (e.finish - e.start) * ns_scale;
+
+                if (x_end - x_start < min_width)
+                {
+                    if (merged.count != 0 && x_start <= merged.x_end + min_width)
                     {
-                        break;
+                        merged.x_end = std::max(merged.x_end, x_end);
+                        merged.finish = std::max(merged.finish, e.finish);
+                        ++merged.count;
+                        return;
                     }
+
+                    draw_merged();
+                    merged = {.x_start = x_start, .x_end = x_end, .start = e.start, .finish = e.finish, .count = 1};
+                    return;
                 }
 
-                // auto const depth = stack.size();
-                auto const depth = 0; // TODO: enable the hierarchy back eventually
-                stack.push_back(i);
+                draw_merged();
 
-                auto const x_start = origin.x + (e.start - min_time) * time_scale;
-                auto const x_end = x_start + (e.finish - e.start) * time_scale;
                 auto const y_top = y + depth * row_height;
                 auto const y_bottom = y_top + row_height - 2;
 
@@ -106,24 +163,47 @@ inline void coroutine_profiler(std::span<trace const> traces)
                 ImVec2 const p1(x_end, y_bottom);
                 auto const color = color_by_tag((uint32_t)e.stage);
 
+                // queueing delay: a thin line from when the coroutine could have run up to when it did
+                auto const queued = e.start > e.wait_finish ? e.start - e.wait_finish : 0;
+                if (queued != 0)
+                {
+                    auto const x_ready = std::max(view_min, x_start - queued * ns_scale);
+                    draw_list->AddLine(ImVec2(x_ready, y_bottom - 1), ImVec2(x_start, y_bottom - 1), color);
+                }
+
                 draw_list->AddRectFilled(p0, p1, color);
-                draw_list->AddText(ImVec2(x_start + 2, y_top + 2), IM_COL32_WHITE, e.name.data(), e.name.data() + e.name.size());
+
+                // names only go on the traces they fit in
+                auto const name = e.name();
+                auto const name_end = name.data() + name.size();
+                if (ImGui::CalcTextSize(name.data(), name_end).x + 4 <= x_end - x_start)
+                    draw_list->AddText(ImVec2(x_start + 2, y_top + 2), IM_COL32_WHITE, name.data(), name_end);
 
                 // Tooltip
                 if (ImGui::IsMouseHoveringRect(p0, p1))
                 {
                     if (ImGui::BeginTooltip())
                     {
-                        ImGui::Text("Name: %.*s [line=%d]", e.name.size(), e.name.data(), e.line);
-                        ImGui::Text("Time: %llu ms", e.start);
-                        ImGui::Text("Duration: %llu ms", e.finish - e.start);
+                        ImGui::Text("Name: %.*s [line=%d]", int(name.size()), name.data(), int(e.line()));
+                        ImGui::Text("Time: %.3f ms", double(e.start) / SDL_NS_PER_MS);
+                        ImGui::Text("Duration: %.3f us", double(e.finish - e.start) / SDL_NS_PER_US);
+                        ImGui::Text("Waited: %.3f ms", double(e.wait_finish - e.wait_start) / SDL_NS_PER_MS);
+                        ImGui::Text("Queued: %.3f us", double(queued) / SDL_NS_PER_US);
+                        ImGui::Text("Coroutine: %#llx", (unsigned long long)e.id);
+                        if (e.parent != 0)
+                            ImGui::Text("Started by: %#llx", (unsigned long long)e.parent);
+                        if (e.flow != flow_kind::none)
+                        {
+                            auto const flow = flow_name(e.flow);
+                            ImGui::Text("Woken by: %#llx (%.*s)", (unsigned long long)e.waker, int(flow.size()), flow.data());
+                        }
                         ImGui::Text("Depth: %d", depth);
                         ImGui::EndTooltip();
                     }
                 }
+            });
 
-                ++i;
-            }
+            draw_merged();
 
             // Handle zooming
             if (ImGui::IsWindowHovered() && ImGui::GetIO().MouseWheel != 0)
@@ -136,3 +216,317 @@ inline void coroutine_profiler(std::span<trace const> traces)
     }
     ImGui::End();
 }
+
+// Shows how many coroutine frames (and how many bytes) each size class of `frames` is holding
+inline void frame_allocator_stats(frame_allocator const &frames)
+{
+    if (ImGui::Begin("Coroutine frames"))
+    {
+        if (ImGui::BeginTable("FrameClasses", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Class");
+            ImGui::TableSetupColumn("Live");
+            ImGui::TableSetupColumn("Peak");
+            ImGui::TableSetupColumn("Allocations");
+            ImGui::TableSetupColumn("Bytes live");
+            ImGui::TableSetupColumn("Bytes reserved");
+            ImGui::TableHeadersRow();
+
+            for (auto &&cls : frames.stats())
+            {
+                ImGui::TableNextRow();
+
+                ImGui::TableNextColumn();
+                if (cls.slot_size != 0)
+                    ImGui::Text("%zu B", cls.slot_size);
+                else
+                    ImGui::TextUnformatted("oversized");
+
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", cls.live);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", cls.peak);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", cls.allocations);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", cls.bytes_live);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", cls.bytes_reserved);
+            }
+
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
+
+// Shows the live coroutine frames of each coroutine function, to catch leaks (frames that pile up) and frames too big to be pooled
+inline void frame_usage_stats(frame_usage const &usage)
+{
+    if (ImGui::Begin("Coroutine frames by function"))
+    {
+        auto const flags = ImGuiTableFlags_Sortable | ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable;
+        if (ImGui::BeginTable("FrameFunctions", 7, flags))
+        {
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("Function", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableSetupColumn("Frame (B)", ImGuiTableColumnFlags_PreferSortDescending);
+            ImGui::TableSetupColumn("Live", ImGuiTableColumnFlags_PreferSortDescending);
+            ImGui::TableSetupColumn("Peak", ImGuiTableColumnFlags_PreferSortDescending);
+            ImGui::TableSetupColumn("Created", ImGuiTableColumnFlags_PreferSortDescending);
+            ImGui::TableSetupColumn("Bytes live", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+            ImGui::TableSetupColumn("Bytes peak", ImGuiTableColumnFlags_PreferSortDescending);
+            ImGui::TableHeadersRow();
+
+            static std::vector<frame_usage::function_stats> functions;
+            functions = usage.stats();
+
+            auto column = 5;
+            auto descending = true;
+            if (auto specs = ImGui::TableGetSortSpecs(); specs && specs->SpecsCount > 0)
+            {
+                column = specs->Specs[0].ColumnIndex;
+                descending = specs->Specs[0].SortDirection == ImGuiSortDirection_Descending;
+            }
+
+            auto key = [&](frame_usage::function_stats const &f) -> std::size_t
+            {
+                switch (column)
+                {
+                case 1:
+                    return f.frame_size;
+                case 2:
+                    return f.live;
+                case 3:
+                    return f.peak;
+                case 4:
+                    return f.created;
+                case 6:
+                    return f.bytes_peak;
+                default:
+                    return f.bytes_live;
+                }
+            };
+
+            std::sort(functions.begin(), functions.end(), [&](frame_usage::function_stats const &lhs, frame_usage::function_stats const &rhs)
+                      {
+                          if (column == 0)
+                              return descending ? rhs.name < lhs.name : lhs.name < rhs.name;
+
+                          return descending ? key(rhs) < key(lhs) : key(lhs) < key(rhs); //
+                      });
+
+            for (auto &&f : functions)
+            {
+                ImGui::TableNextRow();
+
+                ImGui::TableNextColumn();
+                ImGui::Text("%.*s", int(f.name.size()), f.name.data());
+                ImGui::TableNextColumn();
+                if (frame_allocator::slot_size_of(f.frame_size) != 0)
+                    ImGui::Text("%zu", f.frame_size);
+                else
+                    ImGui::Text("%zu (oversized)", f.frame_size);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", f.live);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", f.peak);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", f.created);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", f.bytes_live);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", f.bytes_peak);
+            }
+
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
+
+// Shows how much of its budget each background stage used during the last frame, and how much work it left for the next ones
+inline void background_budgets(std::span<budget_report const> budgets)
+{
+    if (ImGui::Begin("Background stages"))
+    {
+        if (ImGui::BeginTable("Budgets", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Stage");
+            ImGui::TableSetupColumn("Used / budget");
+            ImGui::TableSetupColumn("Resumed");
+            ImGui::TableSetupColumn("High");
+            ImGui::TableSetupColumn("Normal");
+            ImGui::TableSetupColumn("Low");
+            ImGui::TableSetupColumn("Sleeping");
+            ImGui::TableHeadersRow();
+
+            for (auto &&b : budgets)
+            {
+                ImGui::TableNextRow();
+
+                ImGui::TableNextColumn();
+                ImGui::Text("%08x", (uint32_t)b.stage);
+
+                ImGui::TableNextColumn();
+                char label[64];
+                std::snprintf(label, sizeof(label), "%.2f / %.2f ms", double(b.used) / SDL_NS_PER_MS, double(b.budget) / SDL_NS_PER_MS);
+                ImGui::ProgressBar(b.budget == 0 ? 1.0f : float(b.used) / b.budget, ImVec2(-1, 0), label);
+
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", b.resumed);
+
+                for (auto n : b.backlog)
+                {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%zu", n);
+                }
+
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", b.sleeping);
+            }
+
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
+
+// Hot list of the suspend points, sortable by any column, next to a graph of the last frame times with their p50 / p95 / p99
+inline void suspend_point_stats(trace_stats const &stats)
+{
+    if (ImGui::Begin("Suspend points"))
+    {
+        auto const graph_width = 300.0f;
+
+        if (ImGui::BeginChild("HotList", ImVec2(-graph_width, 0)))
+        {
+            auto const flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Sortable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable;
+            if (ImGui::BeginTable("SuspendPoints", 8, flags))
+            {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableSetupColumn("Calls", ImGuiTableColumnFlags_PreferSortDescending);
+                ImGui::TableSetupColumn("Total (ms)", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+                ImGui::TableSetupColumn("Mean (us)", ImGuiTableColumnFlags_PreferSortDescending);
+                ImGui::TableSetupColumn("p50 (us)", ImGuiTableColumnFlags_PreferSortDescending);
+                ImGui::TableSetupColumn("p95 (us)", ImGuiTableColumnFlags_PreferSortDescending);
+                ImGui::TableSetupColumn("p99 (us)", ImGuiTableColumnFlags_PreferSortDescending);
+                ImGui::TableSetupColumn("Max (us)", ImGuiTableColumnFlags_PreferSortDescending);
+                ImGui::TableHeadersRow();
+
+                auto const sites = stats.sites();
+
+                // NOTE: the numbers move every frame, so sort every frame too; there are only so many suspend points
+                static std::vector<std::uint32_t> order;
+                order.resize(sites.size());
+                for (std::uint32_t i{}; i < order.size(); ++i)
+                    order[i] = i;
+
+                auto column = 2;
+                auto descending = true;
+                if (auto specs = ImGui::TableGetSortSpecs(); specs && specs->SpecsCount > 0)
+                {
+                    column = specs->Specs[0].ColumnIndex;
+                    descending = specs->Specs[0].SortDirection == ImGuiSortDirection_Descending;
+                }
+
+                auto key = [&](trace_stats::site_stats const &s) -> Uint64
+                {
+                    switch (column)
+                    {
+                    case 1:
+                        return s.count;
+                    case 3:
+                        return s.mean();
+                    case 4:
+                        return s.durations.percentile(50);
+                    case 5:
+                        return s.durations.percentile(95);
+                    case 6:
+                        return s.durations.percentile(99);
+                    case 7:
+                        return s.max;
+                    default:
+                        return s.total;
+                    }
+                };
+
+                std::sort(order.begin(), order.end(), [&](std::uint32_t lhs, std::uint32_t rhs)
+                          {
+                              if (column == 0)
+                                  return descending ? sites[rhs].name < sites[lhs].name : sites[lhs].name < sites[rhs].name;
+
+                              return descending ? key(sites[rhs]) < key(sites[lhs]) : key(sites[lhs]) < key(sites[rhs]); //
+                          });
+
+                for (auto i : order)
+                {
+                    auto &&s = sites[i];
+                    ImGui::TableNextRow();
+
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.*s [line=%u]", int(s.name.size()), s.name.data(), unsigned(s.line));
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", (unsigned long long)s.count);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", double(s.total) / SDL_NS_PER_MS);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", double(s.mean()) / SDL_NS_PER_US);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", double(s.durations.percentile(50)) / SDL_NS_PER_US);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", double(s.durations.percentile(95)) / SDL_NS_PER_US);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", double(s.durations.percentile(99)) / SDL_NS_PER_US);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", double(s.max) / SDL_NS_PER_US);
+                }
+
+                ImGui::EndTable();
+            }
+        }
+        ImGui::EndChild();
+
+        ImGui::SameLine();
+
+        if (ImGui::BeginChild("FrameTimes", ImVec2(graph_width, 0)))
+        {
+            static std::vector<float> times; // ms
+            times.resize(stats.frames());
+            for (std::size_t i{}; i < times.size(); ++i)
+                times[i] = float(double(stats.frame_time(i)) / SDL_NS_PER_MS);
+
+            auto const ms = [&](double p)
+            { return float(double(stats.frame_percentile(p)) / SDL_NS_PER_MS); };
+
+            auto const p50 = ms(50), p95 = ms(95), p99 = ms(99);
+            auto const scale_max = std::max(ms(100), 1.0f) * 1.1f;
+
+            ImGui::Text("Frame time, last %zu frames", times.size());
+            ImGui::PlotLines("##frame_times", times.data(), int(times.size()), 0, nullptr, 0.0f, scale_max, ImVec2(-1, 150));
+
+            // percentile lines over the graph
+            auto const min = ImGui::GetItemRectMin();
+            auto const max = ImGui::GetItemRectMax();
+            auto draw_list = ImGui::GetWindowDrawList();
+
+            std::pair<float, ImU32> const lines[]{
+                {p50, IM_COL32(120, 255, 180, 255)},
+                {p95, IM_COL32(255, 255, 100, 255)},
+                {p99, IM_COL32(255, 120, 120, 255)},
+            };
+            for (auto &&[value, color] : lines)
+            {
+                auto const y = max.y - (max.y - min.y) * (value / scale_max);
+                draw_list->AddLine(ImVec2(min.x, y), ImVec2(max.x, y), color);
+            }
+
+            ImGui::Text("p50: %.3f ms", p50);
+            ImGui::Text("p95: %.3f ms", p95);
+            ImGui::Text("p99: %.3f ms", p99);
+        }
+        ImGui::EndChild();
+    }
+    ImGui::End();
+}
@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include <queue>
+
 #include "coro/scheduler.hpp"
 #include "coro/task.hpp"
 #include "utils/function_ref.hpp"
@@ -16,21 +18,21 @@ struct racing_coro final
 struct race_scheduler final
 {
     // sync version; run a single step of the race
-    // if return == -1, there are no winners yet
+    // if return == ~uint32_t{}, there are no winners yet
     inline uint32_t step()
     {
         // TODO: update to match the regular scheduler API
         // ^ one option is to pass `ctx` in scheduler's constructor
         // TODO: log the runtimes into the profiler
         auto const n = susp.size();
-        for (size_t i{}; winner == -1 && i < n; ++i)
+        for (size_t i{}; winner == ~uint32_t{} && i < n; ++i)
         {
             auto hnd = susp.front();
             susp.pop();
             hnd.resume();
         }
 
-        if (winner != -1)
+        if (winner != ~uint32_t{})
         {
             while (!susp.empty())
             {
@@ -48,7 +50,7 @@ struct race_scheduler final
     {
         while (true)
         {
-            if (step() != -1)
+            if (step() != ~uint32_t{})
                 break;
 
             co_await s.sched();
@@ -108,9 +110,10 @@ inline task<uint32_t> race_scope(stage_info &s, function_ref<void(race_scheduler
     co_return co_await race.run_on(s);
 }
 
-struct racing_coro::promise_type final
+struct racing_coro::promise_type final : pooled_frame
 {
-    explicit constexpr promise_type(race_scheduler &ctx, ...) noexcept
+    // NOTE: the parameters after `ctx` can be anything, so `frame_usage` counts every racing coroutine under this constructor
+    explicit promise_type(race_scheduler &ctx, ...) noexcept
         : ctx{&ctx}
     {
         id = ctx.count++;
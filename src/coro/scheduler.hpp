@@ -1,13 +1,31 @@
-
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
 #include <entt/core/utility.hpp>
 #include <entt/container/dense_map.hpp>
+#include "coro/budgeted_stage.hpp"
+#include "coro/frame_allocator.hpp"
 #include "coro/stage.hpp"
+#include "coro/thread_pool.hpp"
+
+// Where a stage may run during `scheduler::run_frame`
+enum class stage_thread
+{
+    any,  // any worker, possibly at the same time as other stages
+    main, // always the thread calling `run_frame` (eg. stages that call SDL)
+};
 
 struct scheduler final
 {
-    scheduler() = default;
+    inline scheduler()
+    {
+        // NOTE: create the built-in stages up front, so that coroutines on workers only ever look them up
+        for (auto sid : {stage_id::startup, stage_id::update, stage_id::render, stage_id::cleanup})
+            stages[sid].id = sid;
+    }
 
     scheduler(scheduler const &) = delete;
     scheduler &operator=(scheduler const &) = delete;
@@ -23,6 +41,293 @@ struct scheduler final
         }
     };
 
+    // Add `sid` to the stages ran by `run_frame`
+    inline void frame_stage(stage_id sid, stage_thread where = stage_thread::any);
+
+    // Make `sid` wait for `dependency` to finish on every `run_frame`; both are added to the frame if needed
+    inline void run_after(stage_id sid, stage_id dependency);
+
+    // Run every frame stage once, each after all of its dependencies.
+    // Stages that don't depend on each other run at the same time on `pool`, if given.
+    // With a non-zero `step`, the time moves forward by exactly `step` ns every frame instead of following the clock (eg. for reproducible headless runs).
+    // The sleepers of every stage, background ones included, follow `ctx.time`; only the measurements (traces, stage and frame timings, background budgets) stay on the clock.
+    // NOTE: `ctx.time` is updated once for the whole frame, and the traces of all stages are merged at the end of the frame
+    inline void run_frame(context &ctx, thread_pool *pool = nullptr, Uint64 step = 0);
+
+    // Run the `background` stages with whatever is left of `frame_time` ns since `run_frame` started, in the order they were created.
+    // NOTE: the budget always follows the clock, even with a fixed `step`; the sleepers follow `ctx.time` like the frame stages
+    // Each stage gets what the ones before it didn't use; the reports go to `ctx.budgets`.
+    inline void run_background(context &ctx, Uint64 frame_time);
+
+    // Whether the last `run_frame` had a fixed `step`; the time of the sleepers then only moves with the frames
+    [[nodiscard]]
+    inline bool is_fixed_step() const noexcept { return fixed_step; }
+
+    // When the earliest sleeper of any stage is due (ns, on the time of `ctx`), or `timer_wheel::never`
+    [[nodiscard]]
+    inline Uint64 next_due()
+    {
+        auto due = timer_wheel::never;
+        for (auto &&[sid, stage] : stages)
+            due = std::min(due, stage.next_due());
+        for (auto &&[sid, stage] : background)
+            due = std::min(due, stage.next_due());
+
+        return due;
+    }
+
+    // coroutines taking `scheduler &` as their first parameter allocate their frames here
+    frame_allocator frames;
+
     std::stop_source stop;
     entt::dense_map<stage_id, stage_info, stage_id_hash> stages;
-};
\ No newline at end of file
+    entt::dense_map<stage_id, budgeted_stage, stage_id_hash> background;
+
+private:
+    struct frame_node final
+    {
+        stage_id sid;
+        stage_thread where;
+        std::vector<std::uint32_t> deps; // indices into `frame_nodes`
+
+        // v-- per frame
+        stage_info *stage = nullptr;
+        std::vector<trace> traces;
+        Uint64 duration = 0, finish = 0; // ns; `finish` is the length of the longest chain ending on this stage
+    };
+
+    inline std::uint32_t node_of(stage_id sid)
+    {
+        auto const it = std::find_if(frame_nodes.begin(), frame_nodes.end(), [&](frame_node const &n)
+                                     { return n.sid == sid; });
+        if (it != frame_nodes.end())
+            return std::uint32_t(it - frame_nodes.begin());
+
+        frame_nodes.push_back({.sid = sid, .where = stage_thread::any});
+        stages[sid].main_bound = false;
+        frame_dirty = true;
+        return std::uint32_t(frame_nodes.size() - 1);
+    }
+
+    // group the stages in levels; a level only depends on the levels before it
+    inline void sort_frame();
+
+    inline void run_node(std::uint32_t idx, Uint64 now)
+    {
+        auto &&node = frame_nodes[idx];
+
+        auto const start = SDL_GetTicksNS();
+        node.stage->run_into(now, node.traces);
+        node.duration = SDL_GetTicksNS() - start;
+    }
+
+    std::vector<frame_node> frame_nodes;
+    std::vector<std::vector<std::uint32_t>> frame_levels;
+    bool frame_dirty = false;
+
+    Uint64 frame_begin = 0; // ns, on the clock; when the last `run_frame` started
+    bool fixed_step = false;
+
+    // v-- scratch for `run_frame`
+    std::vector<std::uint32_t> concurrent, on_caller;
+    std::vector<trace> frame_traces; // every trace of the frame, before it goes to `ctx.traces`
+};
+
+inline void scheduler::frame_stage(stage_id sid, stage_thread where)
+{
+    frame_nodes[node_of(sid)].where = where;
+    stages[sid].main_bound = where == stage_thread::main;
+}
+
+inline void scheduler::run_after(stage_id sid, stage_id dependency)
+{
+    auto const dep = node_of(dependency);
+    auto const node = node_of(sid);
+
+    auto &&deps = frame_nodes[node].deps;
+    if (std::find(deps.begin(), deps.end(), dep) == deps.end())
+        deps.push_back(dep);
+
+    frame_dirty = true;
+}
+
+inline void scheduler::sort_frame()
+{
+    auto const n = frame_nodes.size();
+
+    std::vector<bool> placed(n, false);
+    std::size_t n_placed = 0;
+
+    frame_levels.clear();
+
+    // Kahn's algorithm, one level at a time
+    while (n_placed < n)
+    {
+        auto &&level = frame_levels.emplace_back();
+        for (std::uint32_t i{}; i < n; ++i)
+        {
+            if (placed[i])
+                continue;
+
+            auto const &deps = frame_nodes[i].deps;
+            if (std::all_of(deps.begin(), deps.end(), [&](std::uint32_t d)
+                            { return placed[d]; }))
+                level.push_back(i);
+        }
+
+        // a cycle is a bug in how the stages were declared; without asserts, the stages on it never run
+        assert(!level.empty() && "the stage dependencies have a cycle");
+        if (level.empty())
+        {
+            frame_levels.pop_back();
+            break;
+        }
+
+        for (auto i : level)
+            placed[i] = true;
+        n_placed += level.size();
+    }
+
+    frame_dirty = false;
+}
+
+inline void scheduler::run_frame(context &ctx, thread_pool *pool, Uint64 step)
+{
+    if (frame_dirty)
+        sort_frame();
+
+    frame_begin = SDL_GetTicksNS();
+    fixed_step = step != 0;
+
+    auto const now = step ? ctx.time.now + step : frame_begin;
+    ctx.time = {
+        .delta = now - ctx.time.now,
+        .now = now,
+    };
+
+    // NOTE: look the stages up here, since adding a stage might move the others
+    for (auto &&node : frame_nodes)
+    {
+        node.stage = &stages[node.sid];
+        node.stage->id = node.sid;
+    }
+
+    auto const frame_start = SDL_GetTicksNS();
+
+    for (auto &&level : frame_levels)
+    {
+        concurrent.clear();
+        on_caller.clear();
+
+        // stages with their own workers run alone after the rest, since the pool is busy until then
+        for (auto i : level)
+        {
+            auto &&node = frame_nodes[i];
+            if (node.stage->is_parallel())
+                continue;
+
+            (node.where == stage_thread::main ? on_caller : concurrent).push_back(i);
+        }
+
+        if (pool && !concurrent.empty() && concurrent.size() + on_caller.size() > 1)
+        {
+            auto run_concurrent = [&](std::size_t i, std::uint32_t)
+            {
+                run_node(concurrent[i], now);
+            };
+
+            auto run_on_caller = [&](std::uint32_t worker)
+            {
+                if (worker != 0)
+                    return;
+
+                for (auto i : on_caller)
+                    run_node(i, now);
+            };
+
+            pool->run(concurrent.size(), run_concurrent, run_on_caller);
+        }
+        else
+        {
+            for (auto i : on_caller)
+                run_node(i, now);
+
+            for (auto i : concurrent)
+                run_node(i, now);
+        }
+
+        for (auto i : level)
+        {
+            if (frame_nodes[i].stage->is_parallel())
+                run_node(i, now);
+        }
+    }
+
+    auto const frame_finish = SDL_GetTicksNS();
+
+    // longest chain of dependent stages, weighted by how long each stage took
+    Uint64 critical_path = 0, work = 0;
+    for (auto &&level : frame_levels)
+    {
+        for (auto i : level)
+        {
+            auto &&node = frame_nodes[i];
+
+            Uint64 longest_dep = 0;
+            for (auto d : node.deps)
+                longest_dep = std::max(longest_dep, frame_nodes[d].finish);
+
+            node.finish = longest_dep + node.duration;
+            critical_path = std::max(critical_path, node.finish);
+            work += node.duration;
+        }
+    }
+
+    ctx.frame = {
+        .wall = frame_finish - frame_start,
+        .work = work,
+        .critical_path = critical_path,
+    };
+
+    ctx.stage_times.clear();
+    for (auto &&node : frame_nodes)
+        ctx.stage_times.push_back({.stage = node.sid, .duration = node.duration});
+
+    for (auto &&node : frame_nodes)
+    {
+        frame_traces.insert(frame_traces.end(), node.traces.begin(), node.traces.end());
+        node.traces.clear();
+    }
+
+    std::stable_sort(
+        frame_traces.begin(), frame_traces.end(),
+        [](trace const &lhs, trace const &rhs)
+        { return lhs.start < rhs.start; } //
+    );
+
+    ctx.traces.begin_frame(frame_begin);
+    ctx.traces.push(frame_traces);
+    frame_traces.clear();
+}
+
+inline void scheduler::run_background(context &ctx, Uint64 frame_time)
+{
+    ctx.budgets.clear();
+
+    for (auto &&[sid, stage] : background)
+    {
+        auto const elapsed = SDL_GetTicksNS() - frame_begin;
+        auto const budget = elapsed < frame_time ? frame_time - elapsed : 0;
+
+        auto const first_trace = frame_traces.size();
+
+        auto &&report = ctx.budgets.emplace_back(stage.run_into(ctx.time.now, budget, frame_traces));
+        report.stage = sid;
+
+        for (auto i = first_trace; i < frame_traces.size(); ++i)
+            frame_traces[i].stage = sid;
+    }
+
+    ctx.traces.push(frame_traces);
+    frame_traces.clear();
+}
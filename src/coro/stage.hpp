@@ -1,37 +1,82 @@
-
-
 #pragma once
 
+#include <algorithm>
+#include <cassert>
 #include <coroutine>
-#include <queue>
+#include <mutex>
+#include <optional>
 #include <source_location>
 #include <span>
 #include <stop_token>
+#include <utility>
+#include <vector>
 
 #include <SDL3/SDL_timer.h>
 
 #include "coro/fire_and_forget.hpp"
 #include "coro/profiler.hpp"
+#include "coro/thread_pool.hpp"
+#include "coro/timer_wheel.hpp"
+#include "coro/trace_ring.hpp"
+
+#include "utils/atomic_stack.hpp"
+#include "utils/intrusive_list.hpp"
+#include "utils/spin_lock.hpp"
+
+// NOTE: stages resume everything on the thread calling `run`, unless they are given a `thread_pool` through `set_workers`
 
-#include "utils/func_name.hpp"
+// NOTE: every resume is traced unless the build says otherwise, see `tracing`
 
-// NOTE: this is not multi-threaded yet
+// NOTE: all times are in ns from `SDL_GetTicksNS`, except the sleep durations and the `timer_wheel` ticks which stay in ms
+
+// NOTE: scheduling never allocates: every suspended coroutine is linked into its stage through a `coro_state` that lives in its awaiter, hence in the coroutine frame.
+// When a coroutine suspends on a stage, its awaiter hands the thread straight to the next coroutine of the current run (symmetric transfer, see `stage_info::transfer`).
+// Chains of transfers are cut every `stage_info::max_transfers`, since compilers only turn them into tail calls when optimizing.
 
 // TODO:
-// - bring back scheduler, but drop the executor for stages
-// - keep track of the enqueue time for each coroutine
-// - how do you keep track of starting `co_await` time and then enqueue time and then execution duration?
-// ^ probably best for the trace to have wait_start + wait_finish fields to denote when the wait started and when the wait completed
-// - schedule coroutines to a specific thread
 // - show sleeps + other awaitables
 // ^ sleep will overlap with other tasks; how do you denote that?
-// - you can distinct coroutines by hash(handle) and keep all events from one task in one vector
-// - show an arrow to denote tasks that call other tasks
+// - keep all events from one task in one vector (see `trace::id`)
+// - show an arrow to denote tasks that call other tasks; `trace::parent` and `trace::waker` have the links, only the Chrome export draws them yet
 
 struct coro_state final
 {
     std::coroutine_handle<> hnd;
     std::source_location suspend_point;
+    std::uint32_t thread = any_thread; // thread the coroutine is pinned to; see `stage_info::on_main_thread`
+
+    // see `trace`; whatever wakes the coroutine up sets `waker` and `flow`
+    coro_id parent = 0, waker = 0;
+    flow_kind flow = flow_kind::none;
+
+    // see `trace`; `schedule` sets them to the current time if left at 0 (see `stage_info::stamp_wait`)
+    Uint64 wait_start = 0, wait_finish = 0;
+
+    coro_state *next = nullptr; // see `coro_list` and `coro_stack`
+
+    // The state of `hnd` suspending at `sl`, on `thread`, linked to the coroutine that started it
+    template <typename P>
+    inline static coro_state of(std::coroutine_handle<P> hnd, std::source_location const &sl, std::uint32_t thread) noexcept
+    {
+        return {.hnd = hnd, .suspend_point = sl, .thread = thread, .parent = parent_of(hnd)};
+    }
+
+    // For whatever wakes the coroutine up, before scheduling it
+    inline void woken_by(coro_id by, flow_kind kind) noexcept
+    {
+        waker = by;
+        flow = kind;
+    }
+};
+
+using coro_list = intrusive_list<coro_state>;
+using coro_stack = atomic_stack<coro_state>;
+
+// A coroutine waiting on a `timer_wheel`; `when` is in ms
+struct sleeper final : timer_node
+{
+    coro_state state;
+    bool stopped = false; // whether it left the timer before `when`, see `stage_info::cancel`
 };
 
 struct context;
@@ -51,18 +96,149 @@ struct stage_info final
 
     inline void run(context &ctx);
 
-    // Schedule the coroutine for the next time this stage runs
-    inline void schedule(std::coroutine_handle<> hnd, std::source_location const &sl = std::source_location::current())
+    // Same as `run`, but doesn't touch any `context`: the caller keeps the time up to date and the traces go to `out`.
+    // Used by `scheduler::run_frame`, which runs independent stages at the same time.
+    inline void run_into(Uint64 now, std::vector<trace> &out);
+
+    // Opt in to resume the coroutines of this stage on the workers of `pool` as well; `nullptr` goes back to the calling thread only.
+    // `run` still returns only when every coroutine of this run is done.
+    // NOTE: coroutines that must stay on the thread calling `run` (eg. for SDL or ImGui) should `co_await on_main_thread()` first
+    inline void set_workers(thread_pool *pool)
     {
-        ready_queue.push({hnd, sl});
+        workers = pool;
+
+        std::scoped_lock lk{lock};
+        if (pool && pinned.size() < pool->size())
+            pinned.resize(pool->size());
     }
 
-    // Schedule the coroutine to run after `ms` time
-    inline void schedule_after(std::coroutine_handle<> hnd, Uint64 ms, std::source_location const &sl = std::source_location::current())
+    [[nodiscard]]
+    inline bool is_parallel() const noexcept { return workers != nullptr; }
+
+    // what the traces of this stage are tagged with; set by `scheduler`
+    stage_id id = stage_id::_custom;
+
+    // `false` if `scheduler::run_frame` may run this stage on a worker (see `stage_thread::any`); set by `scheduler`
+    bool main_bound = true;
+
+    // Schedule the coroutine of `t` for the next time this stage runs, on the thread it is pinned to.
+    // NOTE: `t` is linked as is, so it must stay alive until the coroutine is resumed (eg. keep it in the awaiter)
+    inline void schedule(coro_state &t)
+    {
+        stamp_wait(t);
+
+        std::scoped_lock lk{lock};
+        queue_of(t.thread).push_one(t);
+    }
+
+    // Schedule every coroutine of `top`, a chain linked through `coro_state::next` (eg. from `coro_stack::take_all`), for the next time this stage runs.
+    // Lock-free, so it can be called from any thread (eg. workers, SDL callbacks); the bottom of the chain runs first, after whatever was already scheduled.
+    // NOTE: the same lifetime rules as `schedule` apply
+    inline void post(coro_state *top) noexcept
+    {
+        if (!top)
+            return;
+
+        auto last = top;
+        for (;; last = last->next)
+        {
+            stamp_wait(*last);
+            if (!last->next)
+                break;
+        }
+
+        posted.push_chain(*top, *last);
+    }
+
+    // Schedule the coroutine of `s` to run after `ms` time; the same lifetime rules as `schedule` apply
+    inline void schedule_after(sleeper &s, Uint64 ms)
+    {
+        if constexpr (tracing::policy != trace_policy::off)
+            s.state.wait_start = SDL_GetTicksNS();
+
+        std::scoped_lock lk{lock};
+        s.when = SDL_NS_TO_MS(time) + ms;
+        waiting.insert(s);
+    }
+
+    // Same as `schedule_after`, except the coroutine is scheduled for the next run right away if `stop` was requested already (see `cancel`)
+    inline void schedule_after(sleeper &s, Uint64 ms, std::stop_token const &stop)
+    {
+        if constexpr (tracing::policy != trace_policy::off)
+            s.state.wait_start = SDL_GetTicksNS();
+
+        std::scoped_lock lk{lock};
+
+        // NOTE: checked under the lock, so a `cancel` from another thread either came before and found nothing, or comes after and takes `s` off the timer
+        if (stop.stop_requested())
+        {
+            s.stopped = true;
+            stamp_wait(s.state);
+            queue_of(s.state.thread).push_one(s.state);
+            return;
+        }
+
+        s.when = SDL_NS_TO_MS(time) + ms;
+        waiting.insert(s);
+    }
+
+    // Take the coroutine of `s` off the timer and schedule it for the next time this stage runs, without waiting for its deadline.
+    // Returns `false` if it isn't waiting anymore (eg. it is due already).
+    inline bool cancel(sleeper &s)
+    {
+        std::scoped_lock lk{lock};
+        if (!waiting.remove(s))
+            return false;
+
+        s.stopped = true; // NOTE: set under the lock, before the coroutine can be resumed
+        s.state.woken_by(current_coro, flow_kind::event);
+        stamp_wait(s.state);
+        queue_of(s.state.thread).push_one(s.state);
+        return true;
+    }
+
+    // Take `s` off the timer without scheduling it, eg. when its coroutine is destroyed while sleeping.
+    // Returns `false` if it isn't waiting anymore.
+    inline bool forget(sleeper &s)
+    {
+        std::scoped_lock lk{lock};
+        return waiting.remove(s);
+    }
+
+    // When the earliest sleeper of this stage is due (ns), or `timer_wheel::never`; eg. to know how long the thread can idle.
+    // NOTE: can be a bit early for sleepers more than 64ms away, see `timer_wheel::next_due`
+    [[nodiscard]]
+    inline Uint64 next_due()
     {
-        waiting.push({hnd, sl, time + ms});
+        std::scoped_lock lk{lock};
+        auto const due = waiting.next_due();
+        return due == timer_wheel::never ? due : SDL_MS_TO_NS(due);
     }
 
+    // Set the wait times of `t` to now if they are left at 0; only the traces use them, so they stay at 0 when tracing is compiled out
+    inline static void stamp_wait(coro_state &t) noexcept
+    {
+        if constexpr (tracing::policy != trace_policy::off)
+        {
+            auto const now = SDL_GetTicksNS();
+            if (t.wait_start == 0)
+                t.wait_start = now;
+            if (t.wait_finish == 0)
+                t.wait_finish = now;
+        }
+    }
+
+    // The thread the running coroutine is pinned to, or `any_thread`.
+    // Awaiters pass it along when scheduling, so a pinned coroutine stays on its thread across `sched()`, `sleep()` and events, on any stage.
+    [[nodiscard]]
+    inline static std::uint32_t current_thread() noexcept { return pinned_to; }
+
+    // For awaiters, once `hnd` is scheduled somewhere: if `hnd` is the coroutine the current run resumed, finish its trace and return the next coroutine of the run to resume instead.
+    // Returns `std::noop_coroutine()` when there's nothing to transfer to, so the result can be returned from `await_suspend` as is.
+    // NOTE: call it with nothing but locals, since `hnd` might be resumed by another thread already
+    [[nodiscard]]
+    inline static std::coroutine_handle<> transfer(std::coroutine_handle<> hnd) noexcept;
+
     // Schedule the coroutine for the next time this stage runs
     struct sched_awaiter;
     inline sched_awaiter sched() noexcept;
@@ -71,121 +247,490 @@ struct stage_info final
     struct sleep_awaiter;
     inline sleep_awaiter sleep(Uint64 ms) noexcept;
 
+    // Same as `sched`, but doesn't suspend if `stop` was requested already; `co_await` gives `false` if it was by the time the coroutine resumes, `true` otherwise.
+    // NOTE: a scheduled coroutine runs on the next run anyway, so there is nothing to cancel once it is queued
+    struct stoppable_sched_awaiter;
+    inline stoppable_sched_awaiter sched(std::stop_token stop) noexcept;
+
+    // Same as `sleep`, but wakes up as soon as `stop` is requested: the coroutine leaves the timer at once and resumes on the next run of this stage.
+    // `co_await` gives `false` if `stop` was requested, `true` if the time ran out; whichever came first, even if the other one happens before the coroutine resumes.
+    struct stoppable_sleep_awaiter;
+    inline stoppable_sleep_awaiter sleep(Uint64 ms, std::stop_token stop) noexcept;
+
+    struct pin_awaiter;
+
+    // Pin the coroutine to the thread calling `run` (eg. for SDL or ImGui calls) and schedule it for the next time this stage runs.
+    // NOTE: only for stages that always run on the main thread, see `main_bound`
+    inline pin_awaiter on_main_thread() noexcept;
+
+    // Pin the coroutine to the `n`th worker of the pool and schedule it for the next time this stage runs.
+    // NOTE: if the pool has fewer workers, the index wraps around (possibly to the main thread); without a pool everything runs on the calling thread
+    inline pin_awaiter on_worker(std::uint32_t n) noexcept;
+
+    // Let the coroutine run on any thread again and schedule it for the next time this stage runs
+    inline pin_awaiter on_any_thread() noexcept;
+
 private:
-    struct waiting_coro final
+    friend struct budgeted_stage;
+
+    // what the thread is resuming right now; see `transfer`
+    struct run_state final
     {
-        std::coroutine_handle<> hnd;
-        std::source_location suspend_point;
-        Uint64 when_ready;
+        coro_list *queue; // what's left of the run on this thread
+        std::vector<trace> *out;
+        bool recording;      // `tracing::is_recording`, read once per run
+        coro_state current;  // copy of the state of the running coroutine; `hnd` is null once it gave the thread back
+        bool traced = false; // whether `current` gets a trace, see `tracing::policy`
+        Uint64 start = 0;
+        std::uint32_t transfers = 0; // since the loop of `run_list` last resumed a coroutine, see `max_transfers`
+
+        // `now` can be 0 when the clock wasn't read yet
+        inline void begin(coro_state const &t, Uint64 now) noexcept
+        {
+            current = t;
+            pinned_to = t.thread;
+            current_coro = id_of(t.hnd);
 
-        struct compare_time final
+            traced = sample();
+            if (traced)
+                start = now != 0 ? now : SDL_GetTicksNS();
+        }
+
+        // Finish the trace of `current`, if it has one; returns when it finished, or 0 when the clock wasn't read
+        inline Uint64 end();
+
+        [[nodiscard]]
+        inline bool sample() const noexcept
         {
-            constexpr bool operator()(waiting_coro lhs, waiting_coro rhs) noexcept
-            {
-                return lhs.when_ready > rhs.when_ready;
-            }
-        };
+            if constexpr (tracing::policy == trace_policy::off)
+                return false;
+            else if constexpr (tracing::policy == trace_policy::sampled)
+                return recording && ++resumes % tracing::sample_every == 0;
+            else
+                return recording;
+        }
     };
 
-    Uint64 time = SDL_GetTicks();
+    // NOTE: call while holding `lock`
+    inline coro_list &queue_of(std::uint32_t thread)
+    {
+        if (thread == any_thread)
+            return ready;
+
+        if (thread >= pinned.size())
+            pinned.resize(thread + 1);
+
+        return pinned[thread];
+    }
+
+    // Resume every coroutine of `list` in order, tracing them into `out`.
+    // Coroutines that suspend on a stage pass the thread to the next one directly (see `transfer`), the loop only takes over when a chain breaks.
+    inline static void run_list(coro_list &list, std::vector<trace> &out);
+
+    inline static void run_one(coro_state &t, std::vector<trace> &out)
+    {
+        coro_list one;
+        one.push_one(t);
+        run_list(one, out);
+    }
+
+    // Unoptimized builds keep the frame of every hop of a transfer chain on the stack, and overflow it with enough ready coroutines;
+    // after this many hops in a row, `transfer` gives the thread back to the loop of `run_list` instead
+    inline static constexpr std::uint32_t max_transfers = 64;
+
+    inline static thread_local std::uint32_t pinned_to = any_thread;
+    inline static thread_local run_state *running = nullptr;
+    inline static thread_local std::uint32_t resumes = 0; // see `trace_policy::sampled`
+
+    Uint64 time = SDL_GetTicksNS();
     Uint64 last_time = time;
-    std::queue<coro_state> ready_queue;
-    std::priority_queue<waiting_coro, std::vector<waiting_coro>, waiting_coro::compare_time> waiting;
+
+    // v-- guarded by `lock`, since coroutines running on workers can schedule into any stage
+    spin_lock lock;
+    coro_list ready;
+    std::vector<coro_list> pinned{1};        // one queue per thread of the pool; `pinned[main_thread]` always exists
+    timer_wheel waiting{SDL_NS_TO_MS(time)}; // ticks are in ms
+
+    coro_stack posted; // see `post`; lock-free, moved to the queues at the start of a run
+
+    // v-- scratch for `run_into`
+    std::vector<coro_list> taken;
+    std::vector<coro_state *> batch;
+
+    // v-- scratch for `run`
+    std::vector<trace> run_traces;
+
+    // v-- parallel mode only
+    thread_pool *workers = nullptr;
+    std::vector<std::vector<trace>> worker_traces;
 };
 
 struct context final
 {
-    // invariant: the loop on `stage_info::run` guarantees the ordering of the traces, so no need for a priority queue
+    // invariant: `stage_info::run` keeps the traces ordered by start time, so no need for a priority queue
+    // in ns, see `SDL_NS_PER_MS` and friends
     struct
     {
-        Uint64 delta = 0, now = SDL_GetTicks();
+        Uint64 delta = 0, now = SDL_GetTicksNS();
     } time;
 
-    std::vector<trace> traces;
+    // sampled on the main thread by the game loop once per frame, so that coroutines on workers can read it
+    struct
+    {
+        float x = 0.0f, y = 0.0f;
+        Uint32 buttons = 0; // see `SDL_BUTTON_LMASK` and friends
+    } mouse;
+
+    // filled by `scheduler::run_frame`, in ns
+    struct
+    {
+        Uint64 wall = 0;          // from the first stage starting to the last one finishing
+        Uint64 work = 0;          // sum of the durations of every stage
+        Uint64 critical_path = 0; // longest chain of dependent stages; the frame can't be shorter than this
+    } frame;
+
+    // how long each stage took during the last `scheduler::run_frame`, in the order they were declared
+    std::vector<stage_timing> stage_times;
+
+    // every resume, up to a memory ceiling (see `trace_ring::set_capacity`)
+    trace_ring traces;
+
+    // what each background stage did during the last `scheduler::run_background`
+    std::vector<budget_report> budgets;
 };
 
+inline Uint64 stage_info::run_state::end()
+{
+    if (!traced)
+    {
+        current.hnd = nullptr;
+        return 0;
+    }
+
+    auto const now = SDL_GetTicksNS();
+    out->push_back({
+        .site = suspend_sites::global().intern(current.suspend_point),
+        // NOTE: `.stage` is set by the stage once the run is over
+        .tid = std::this_thread::get_id(), // TODO: reuse per task
+        .wait_start = current.wait_start,
+        .wait_finish = current.wait_finish,
+        .start = start,
+        .finish = now,
+        .id = id_of(current.hnd),
+        .parent = current.parent,
+        .waker = current.waker,
+        .flow = current.flow,
+    });
+
+    current.hnd = nullptr;
+    return now;
+}
+
+inline void stage_info::run_list(coro_list &list, std::vector<trace> &out)
+{
+    run_state rs{.queue = &list, .out = &out, .recording = tracing::is_recording()};
+
+    auto const outer = std::exchange(running, &rs);
+    auto const outer_pin = pinned_to;
+    auto const outer_coro = current_coro;
+
+    Uint64 now = 0;
+    while (auto t = list.pop())
+    {
+        // NOTE: `t` lives in the awaiter, so it's gone once the coroutine resumes
+        rs.begin(*t, now);
+        rs.transfers = 0;
+        rs.current.hnd.resume();
+
+        now = rs.current.hnd ? rs.end() : 0;
+    }
+
+    pinned_to = outer_pin;
+    current_coro = outer_coro;
+    running = outer;
+}
+
+inline std::coroutine_handle<> stage_info::transfer(std::coroutine_handle<> hnd) noexcept
+{
+    // NOTE: coroutines started from the running one (or tasks it awaits) suspend back into it instead
+    auto rs = running;
+    if (!rs || rs->current.hnd != hnd)
+    {
+        // the thread goes back to whatever resumed or spawned `hnd`
+        current_coro = rs && rs->current.hnd ? id_of(rs->current.hnd) : 0;
+        return std::noop_coroutine();
+    }
+
+    auto const now = rs->end();
+
+    // the loop of `run_list` resumes the next one, from the bottom of the stack
+    if (++rs->transfers == max_transfers)
+        return std::noop_coroutine();
+
+    auto next = rs->queue->pop();
+    if (!next)
+        return std::noop_coroutine();
+
+    rs->begin(*next, now);
+    return rs->current.hnd;
+}
+
 inline void stage_info::run(context &ctx)
 {
-    time = SDL_GetTicks();
+    auto const now = SDL_GetTicksNS();
 
     ctx.time = {
-        .delta = time - last_time,
-        .now = time,
+        .delta = now - last_time,
+        .now = now,
     };
 
-    while (!waiting.empty())
+    run_into(now, run_traces);
+
+    ctx.traces.push(run_traces);
+    run_traces.clear();
+}
+
+inline void stage_info::run_into(Uint64 now, std::vector<trace> &out)
+{
+    time = now;
+
+    auto const n_threads = workers ? workers->size() : 1u;
+
+    // only what is queued now runs; anything scheduled from here on waits for the next run
+    // posted coroutines run after the ones that were already queued, then come the expired sleepers, in whole buckets
+    coro_list now_ready;
     {
-        auto top = waiting.top();
-        if (top.when_ready > time)
-            break;
+        std::scoped_lock lk{lock};
+
+        auto from_posts = posted.take_all_fifo();
+        while (auto t = from_posts.pop())
+            queue_of(t->thread).push_one(*t);
+
+        timer_list due;
+        waiting.advance(SDL_NS_TO_MS(time), due);
+        while (auto node = due.pop())
+        {
+            auto &&s = static_cast<sleeper &>(*node);
+            s.state.wait_finish = SDL_MS_TO_NS(s.when);
+            queue_of(s.state.thread).push_one(s.state);
+        }
+
+        now_ready = std::exchange(ready, {});
 
-        waiting.pop();
-        ready_queue.push({top.hnd, top.suspend_point});
+        taken.resize(pinned.size());
+        for (std::size_t t{}; t < pinned.size(); ++t)
+            taken[t] = std::exchange(pinned[t], {});
     }
 
-    auto const n = ready_queue.size();
-    ctx.traces.reserve(ctx.traces.size() + n);
+    auto const first_trace = out.size();
+    out.reserve(first_trace + now_ready.size);
 
-    auto start = SDL_GetTicks();
+    // thread `i` also takes the queues of the threads the pool doesn't have, see `on_worker`
+    auto run_pinned = [&](std::uint32_t thread, std::vector<trace> &traces)
+    {
+        for (auto t = thread; t < taken.size(); t += n_threads)
+            run_list(taken[t], traces);
+    };
 
-    for (size_t i{}; i < n; ++i)
+    if (!workers)
+    {
+        run_pinned(main_thread, out);
+        run_list(now_ready, out);
+    }
+    else
     {
-        auto t = ready_queue.front();
-        ready_queue.pop();
+        // NOTE: the workers pick coroutines by index, so there's no next one to transfer to; `transfer` still ends their traces
+        batch.clear();
+        while (auto t = now_ready.pop())
+            batch.push_back(t);
+
+        worker_traces.resize(n_threads);
 
-        t.hnd.resume();
+        auto resume_one = [&](std::size_t i, std::uint32_t worker)
+        {
+            run_one(*batch[i], worker_traces[worker]);
+        };
 
-        auto const finish = SDL_GetTicks();
-        auto func_name = t.suspend_point.function_name();
+        // every thread starts with the coroutines pinned to it
+        auto resume_pinned = [&](std::uint32_t worker)
+        {
+            run_pinned(worker, worker == main_thread ? out : worker_traces[worker]);
+        };
 
-        ctx.traces.push_back({
-            .name = trim_func_name(func_name),
-            .line = t.suspend_point.line(),
-            // .stage = id,
-            // TODO: set stage id
-            .tid = std::this_thread::get_id(), // TODO: address when you have multiple threads; reuse per task
-            .start = start,
-            .finish = finish,
-        });
+        workers->run(batch.size(), resume_one, resume_pinned);
 
-        start = finish;
-        // TODO: do you update context time here?
+        for (auto &&traces : worker_traces)
+        {
+            out.insert(out.end(), traces.begin(), traces.end());
+            traces.clear();
+        }
+
+        std::stable_sort(
+            out.begin() + first_trace, out.end(),
+            [](trace const &lhs, trace const &rhs)
+            { return lhs.start < rhs.start; } //
+        );
     }
 
+    for (auto i = first_trace; i < out.size(); ++i)
+        out[i].stage = id;
+
     last_time = time;
 }
 
 struct [[nodiscard]] stage_info::sched_awaiter final
 {
     stage_info *s;
+    coro_state state;
 
     static constexpr bool await_ready() noexcept { return false; }
 
-    inline auto await_suspend(std::coroutine_handle<> hnd,
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd,
                               std::source_location const &sl = std::source_location::current()) noexcept
     {
-        s->schedule(hnd, sl);
-        return std::noop_coroutine();
+        state = coro_state::of(hnd, sl, current_thread());
+        s->schedule(state);
+        return transfer(hnd);
     }
 
     static constexpr void await_resume() noexcept {}
 };
 inline auto stage_info::sched() noexcept -> stage_info::sched_awaiter { return sched_awaiter{this}; }
 
+struct [[nodiscard]] stage_info::pin_awaiter final
+{
+    stage_info *s;
+    std::uint32_t thread;
+    coro_state state;
+
+    static constexpr bool await_ready() noexcept { return false; }
+
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd,
+                              std::source_location const &sl = std::source_location::current()) noexcept
+    {
+        state = coro_state::of(hnd, sl, thread);
+        s->schedule(state);
+        return transfer(hnd);
+    }
+
+    static constexpr void await_resume() noexcept {}
+};
+inline auto stage_info::on_main_thread() noexcept -> stage_info::pin_awaiter
+{
+    // parallel stages resume the coroutines pinned to the main thread on it, whatever they were declared with
+    assert((main_bound || is_parallel()) && "on_main_thread() on a stage that can run on a worker; declare it with `stage_thread::main`");
+    return pin_awaiter{this, main_thread};
+}
+inline auto stage_info::on_worker(std::uint32_t n) noexcept -> stage_info::pin_awaiter { return pin_awaiter{this, n + 1}; }
+inline auto stage_info::on_any_thread() noexcept -> stage_info::pin_awaiter { return pin_awaiter{this, any_thread}; }
+
 struct [[nodiscard]] stage_info::sleep_awaiter final
 {
     stage_info *s;
     Uint64 ms;
+    sleeper node;
+    bool sleeping = false; // only touched by the coroutine, unlike `node`
+
+    // destroyed while sleeping (eg. the coroutine lost a race): don't leave `node` on the timer
+    inline ~sleep_awaiter()
+    {
+        if (sleeping)
+            s->forget(node);
+    }
 
     static constexpr bool await_ready() noexcept { return false; }
 
-    inline auto await_suspend(std::coroutine_handle<> hnd,
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd,
                               std::source_location const &sl = std::source_location::current()) noexcept
     {
-        s->schedule_after(hnd, ms, sl);
-        return std::noop_coroutine();
+        node.state = coro_state::of(hnd, sl, current_thread());
+        sleeping = true;
+        s->schedule_after(node, ms);
+        return transfer(hnd);
     }
 
-    static constexpr void await_resume() noexcept {}
+    inline void await_resume() noexcept { sleeping = false; }
 };
 inline auto stage_info::sleep(Uint64 ms) noexcept -> stage_info::sleep_awaiter { return sleep_awaiter{this, ms}; }
+
+struct [[nodiscard]] stage_info::stoppable_sched_awaiter final
+{
+    stage_info *s;
+    std::stop_token stop;
+    coro_state state;
+
+    inline bool await_ready() const noexcept { return stop.stop_requested(); }
+
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd,
+                              std::source_location const &sl = std::source_location::current()) noexcept
+    {
+        state = coro_state::of(hnd, sl, current_thread());
+        s->schedule(state);
+        return transfer(hnd);
+    }
+
+    inline bool await_resume() const noexcept { return !stop.stop_requested(); }
+};
+inline auto stage_info::sched(std::stop_token stop) noexcept -> stage_info::stoppable_sched_awaiter { return stoppable_sched_awaiter{this, std::move(stop)}; }
+
+struct [[nodiscard]] stage_info::stoppable_sleep_awaiter final
+{
+    struct canceller final
+    {
+        stage_info *s;
+        sleeper *node;
+
+        inline void operator()() const noexcept { s->cancel(*node); }
+    };
+
+    stage_info *s;
+    Uint64 ms;
+    std::stop_token stop;
+    sleeper node;
+    bool sleeping = false; // see `sleep_awaiter::sleeping`
+    std::optional<std::stop_callback<canceller>> on_stop; // NOTE: last, so that it's gone before `node` is
+
+    // destroyed while sleeping (eg. the coroutine lost a race): don't leave `node` on the timer
+    inline ~stoppable_sleep_awaiter()
+    {
+        if (!sleeping)
+            return;
+
+        on_stop.reset(); // waits for a `cancel` running on another thread
+        s->forget(node);
+    }
+
+    inline bool await_ready() noexcept
+    {
+        node.stopped = stop.stop_requested();
+        return node.stopped;
+    }
+
+    template <typename P>
+    inline auto await_suspend(std::coroutine_handle<P> hnd,
+                              std::source_location const &sl = std::source_location::current()) noexcept
+    {
+        node.state = coro_state::of(hnd, sl, current_thread());
+
+        // NOTE: the callback can run right away, before `node` is on the timer; `schedule_after` sees the stop then
+        sleeping = true;
+        on_stop.emplace(stop, canceller{s, &node});
+        s->schedule_after(node, ms, stop);
+        return transfer(hnd);
+    }
+
+    // NOTE: a stop requested once the time ran out doesn't count, since the sleep was over already
+    inline bool await_resume() noexcept
+    {
+        sleeping = false;
+        return !node.stopped;
+    }
+};
+inline auto stage_info::sleep(Uint64 ms, std::stop_token stop) noexcept -> stage_info::stoppable_sleep_awaiter
+{
+    return stoppable_sleep_awaiter{this, ms, std::move(stop)};
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <source_location>
+#include <string_view>
+
+#include <entt/container/dense_map.hpp>
+#include "utils/func_name.hpp"
+
+// Every suspend point seen so far, by id; the same `std::source_location` always gets the same id, and ids go up from 0.
+// The name is trimmed once, when a suspend point shows up for the first time, so that traces only carry the id.
+// NOTE: thread-safe; looking up an id never locks, and interning only locks the first time a thread sees a suspend point
+struct suspend_sites final
+{
+    static constexpr std::size_t chunk_size = 1024;
+    static constexpr std::size_t max_chunks = 1024; // ~1M suspend points
+
+    struct site final
+    {
+        std::string_view name;
+        uint_least32_t line;
+    };
+
+    [[nodiscard]]
+    inline static suspend_sites &global() noexcept
+    {
+        static suspend_sites sites;
+        return sites;
+    }
+
+    // NOTE: past `chunk_size * max_chunks` suspend points, the last one takes them all
+    [[nodiscard]]
+    inline std::uint32_t intern(std::source_location const &sl);
+
+    // NOTE: `id` must come from `intern`
+    [[nodiscard]]
+    inline site const &operator[](std::uint32_t id) const noexcept
+    {
+        return chunks[id / chunk_size][id % chunk_size];
+    }
+
+    [[nodiscard]]
+    inline std::size_t size() const noexcept { return count.load(std::memory_order_acquire); }
+
+private:
+    // NOTE: `function_name` comes from `std::source_location`, so the same suspend point always has the same pointer
+    struct key final
+    {
+        char const *function_name;
+        uint_least32_t line, column;
+
+        constexpr bool operator==(key const &) const noexcept = default;
+    };
+
+    struct key_hash final
+    {
+        inline std::size_t operator()(key k) const noexcept
+        {
+            return std::hash<char const *>{}(k.function_name) ^ ((std::size_t(k.line) << 16 | k.column) * 0x9e3779b97f4a7c15ull);
+        }
+    };
+
+    // v-- guarded by `lock`; chunks never move once allocated, so readers don't need it
+    std::mutex lock;
+    entt::dense_map<key, std::uint32_t, key_hash> ids;
+    std::array<std::unique_ptr<site[]>, max_chunks> chunks;
+    std::atomic<std::size_t> count = 0;
+
+    inline static thread_local entt::dense_map<key, std::uint32_t, key_hash> cache;
+};
+
+inline std::uint32_t suspend_sites::intern(std::source_location const &sl)
+{
+    auto const k = key{sl.function_name(), sl.line(), sl.column()};
+    if (auto const it = cache.find(k); it != cache.end())
+        return it->second;
+
+    std::scoped_lock lk{lock};
+
+    auto it = ids.find(k);
+    if (it == ids.end())
+    {
+        auto const n = count.load(std::memory_order_relaxed);
+        if (n == chunk_size * max_chunks)
+            return std::uint32_t(n - 1);
+
+        auto &&chunk = chunks[n / chunk_size];
+        if (!chunk)
+            chunk = std::make_unique<site[]>(chunk_size);
+
+        chunk[n % chunk_size] = {trim_func_name(sl.function_name()), sl.line()};
+        it = ids.emplace(k, std::uint32_t(n)).first;
+        count.store(n + 1, std::memory_order_release);
+    }
+
+    cache.emplace(k, it->second);
+    return it->second;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+
+#include "coro/stage.hpp"
+#include "utils/spin_lock.hpp"
+
+struct latch_awaiter;
+
+// Fan-in for coroutines: `co_await` suspends until `count_down` was called `count` times in total, eg. until every load of a level is done.
+// The waiting coroutines are resumed on the stage given at construction; once open, the latch stays open.
+// NOTE: thread-safe; the latch must outlive every coroutine waiting on it
+struct latch final
+{
+    inline latch(stage_info &s, std::size_t count) : s{&s}, count{count} {}
+
+    latch(latch const &) = delete;
+    latch &operator=(latch const &) = delete;
+
+    // NOTE: counting down more than what is left is a bug, like for `std::latch`
+    inline void count_down(std::size_t n = 1)
+    {
+        std::scoped_lock lk{lock};
+        count -= n;
+        if (count != 0)
+            return;
+
+        while (auto state = waiting.pop())
+        {
+            state->woken_by(current_coro, flow_kind::event);
+            s->schedule(*state);
+        }
+    }
+
+    [[nodiscard]]
+    inline bool is_open() noexcept
+    {
+        std::scoped_lock lk{lock};
+        return count == 0;
+    }
+
+    [[nodiscard("Must be `co_await`")]]
+    inline latch_awaiter operator co_await() noexcept;
+
+private:
+    stage_info *s;
+
+    // v-- guarded by `lock`, since coroutines running on workers can count down
+    spin_lock lock;
+    std::size_t count;
+    coro_list waiting;
+
+    friend latch_awaiter;
+};
+
+struct latch_awaiter final
+{
+    latch *l;
+    coro_state state;
+
+    inline bool await_ready() noexcept { return l->is_open(); }
+
+    template <typename P>
+    inline std::coroutine_handle<> await_suspend(std::coroutine_handle<P> hnd, std::source_location const &sl = std::source_location::current()) noexcept
+    {
+        state = coro_state::of(hnd, sl, stage_info::current_thread());
+        {
+            std::scoped_lock lk{l->lock};
+
+            // opened since `await_ready`
+            if (l->count == 0)
+                return hnd;
+
+            l->waiting.push_one(state);
+        }
+
+        return stage_info::transfer(hnd);
+    }
+
+    static constexpr void await_resume() noexcept {}
+};
+
+inline latch_awaiter latch::operator co_await() noexcept { return latch_awaiter{this}; }
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <utility>
+
+#include "coro/sync/semaphore.hpp"
+
+// Mutex for coroutines: held across suspension points, and waiting for it suspends the coroutine instead of the thread.
+// Waiters get it in the order they came, resumed on the stage given at construction.
+// Example:
+// ```cpp
+// auto lk = co_await mtx.lock();
+// co_await save(shared); // still held
+// ```                    // unlocked when `lk` goes out of scope
+// NOTE: thread-safe; the mutex must outlive every coroutine waiting on it
+struct async_mutex final
+{
+    // Unlocks the mutex when destroyed
+    struct [[nodiscard("The mutex is unlocked as soon as the guard is destroyed")]] guard final
+    {
+        inline explicit guard(async_mutex &m) noexcept : m{&m} {}
+
+        guard(guard const &) = delete;
+        guard &operator=(guard const &) = delete;
+
+        inline guard(guard &&other) noexcept : m{std::exchange(other.m, nullptr)} {}
+
+        inline ~guard()
+        {
+            if (m)
+                m->unlock();
+        }
+
+    private:
+        async_mutex *m;
+    };
+
+    struct lock_awaiter;
+
+    inline explicit async_mutex(stage_info &s) : units{s, 1} {}
+
+    // `co_await` gives a `guard` once the coroutine holds the mutex
+    [[nodiscard("Must be `co_await`")]]
+    inline lock_awaiter lock() noexcept;
+
+    // Lock without waiting; returns `false` if the mutex is held
+    [[nodiscard]]
+    inline bool try_lock() noexcept { return units.try_acquire(); }
+
+    // NOTE: only call after `try_lock` succeeded; `guard` does it otherwise
+    inline void unlock() { units.release(); }
+
+private:
+    async_semaphore units;
+};
+
+struct [[nodiscard]] async_mutex::lock_awaiter final
+{
+    async_mutex *m;
+    async_semaphore_awaiter acquire;
+
+    inline bool await_ready() noexcept { return acquire.await_ready(); }
+
+    template <typename P>
+    inline std::coroutine_handle<> await_suspend(std::coroutine_handle<P> hnd, std::source_location const &sl = std::source_location::current()) noexcept
+    {
+        return acquire.await_suspend(hnd, sl);
+    }
+
+    inline guard await_resume() const noexcept { return guard{*m}; }
+};
+
+inline async_mutex::lock_awaiter async_mutex::lock() noexcept { return lock_awaiter{this, units.acquire()}; }
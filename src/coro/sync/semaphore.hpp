@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+
+#include "coro/stage.hpp"
+#include "utils/spin_lock.hpp"
+
+struct async_semaphore_awaiter;
+
+// Counting semaphore for coroutines, eg. to cap how many loads are in flight at once.
+// `co_await acquire()` takes a unit, suspending until there is one; `release` hands units to the waiting coroutines first, in the order they came, on the stage given at construction.
+// Nothing is allocated: the waiting coroutines link themselves through their awaiters.
+// NOTE: thread-safe; the semaphore must outlive every coroutine waiting on it
+struct async_semaphore final
+{
+    inline async_semaphore(stage_info &s, std::size_t count) : s{&s}, count{count} {}
+
+    async_semaphore(async_semaphore const &) = delete;
+    async_semaphore &operator=(async_semaphore const &) = delete;
+
+    [[nodiscard("Must be `co_await`")]]
+    inline async_semaphore_awaiter acquire() noexcept;
+
+    // Take a unit without waiting; returns `false` if there is none
+    [[nodiscard]]
+    inline bool try_acquire() noexcept
+    {
+        std::scoped_lock lk{lock};
+        return try_acquire_locked();
+    }
+
+    inline void release(std::size_t n = 1)
+    {
+        std::scoped_lock lk{lock};
+        for (; n != 0; --n)
+        {
+            auto state = waiting.pop();
+            if (!state)
+                break;
+
+            // the unit goes straight to the waiter, so no one can take it in between
+            state->woken_by(current_coro, flow_kind::event);
+            s->schedule(*state);
+        }
+
+        count += n;
+    }
+
+private:
+    // NOTE: call while holding `lock`
+    inline bool try_acquire_locked() noexcept
+    {
+        if (count == 0)
+            return false;
+
+        --count;
+        return true;
+    }
+
+    stage_info *s;
+
+    // v-- guarded by `lock`, since coroutines running on workers can acquire and release
+    spin_lock lock;
+    std::size_t count;
+    coro_list waiting; // only while `count` is 0
+
+    friend async_semaphore_awaiter;
+};
+
+struct [[nodiscard]] async_semaphore_awaiter final
+{
+    async_semaphore *sem;
+    coro_state state;
+
+    inline bool await_ready() noexcept { return sem->try_acquire(); }
+
+    template <typename P>
+    inline std::coroutine_handle<> await_suspend(std::coroutine_handle<P> hnd, std::source_location const &sl = std::source_location::current()) noexcept
+    {
+        state = coro_state::of(hnd, sl, stage_info::current_thread());
+        {
+            std::scoped_lock lk{sem->lock};
+
+            // released since `await_ready`
+            if (sem->try_acquire_locked())
+                return hnd;
+
+            sem->waiting.push_one(state);
+        }
+
+        return stage_info::transfer(hnd);
+    }
+
+    static constexpr void await_resume() noexcept {}
+};
+
+inline async_semaphore_awaiter async_semaphore::acquire() noexcept { return async_semaphore_awaiter{this}; }
@@ -3,6 +3,10 @@
 
 #include <coroutine>
 #include <optional>
+#include <source_location>
+
+#include "coro/coro_id.hpp"
+#include "coro/frame_allocator.hpp"
 
 template <typename T>
 struct task_promise;
@@ -22,7 +26,8 @@ struct [[nodiscard("task is a RAII type and should be `co_await`.\n"
 
     inline task &operator=(task &&t) noexcept
     {
-        if (hnd && !hnd.done())
+        // NOTE: finished tasks stay suspended at `final_suspend`, so they still need to be destroyed
+        if (hnd)
             hnd.destroy();
 
         hnd = t.hnd;
@@ -33,7 +38,7 @@ struct [[nodiscard("task is a RAII type and should be `co_await`.\n"
 
     inline ~task()
     {
-        if (hnd && !hnd.done())
+        if (hnd)
             hnd.destroy();
     }
 
@@ -49,11 +54,14 @@ private:
 };
 
 template <typename T>
-struct task_promise_base
+struct task_promise_base : pooled_frame
 {
     struct final_awaiter;
 
+    inline explicit task_promise_base(std::source_location const &sl) : pooled_frame{sl} {}
+
     std::coroutine_handle<> cont = std::noop_coroutine();
+    coro_id parent = 0; // `cont`, for the traces
 
     static constexpr auto initial_suspend() noexcept { return std::suspend_always{}; }
     static constexpr final_awaiter final_suspend() noexcept;
@@ -64,6 +72,10 @@ struct task_promise_base
 template <typename T>
 struct task_promise final : task_promise_base<T>
 {
+    // NOTE: called by the compiler from the coroutine, so `sl` is the coroutine function (see `frame_usage`)
+    inline task_promise(std::source_location const &sl = std::source_location::current())
+        : task_promise_base<T>{sl} {}
+
     std::optional<T> value;
 
     inline task<T> get_return_object() noexcept { return task{*this}; }
@@ -73,6 +85,9 @@ struct task_promise final : task_promise_base<T>
 template <>
 struct task_promise<void> : task_promise_base<void>
 {
+    inline task_promise(std::source_location const &sl = std::source_location::current())
+        : task_promise_base<void>{sl} {}
+
     inline task<> get_return_object() noexcept { return task{*this}; }
     constexpr void return_void() const noexcept {}
 };
@@ -84,6 +99,7 @@ struct task_promise_base<T>::final_awaiter final
 
     inline static auto await_suspend(std::coroutine_handle<task_promise<T>> hnd) noexcept
     {
+        current_coro = hnd.promise().parent;
         return hnd.promise().cont;
     }
 
@@ -103,6 +119,8 @@ struct task<T>::awaiter_type final
     inline auto await_suspend(std::coroutine_handle<> hnd) const noexcept
     {
         this->hnd.promise().cont = hnd;
+        this->hnd.promise().parent = id_of(hnd);
+        current_coro = id_of(this->hnd);
         return this->hnd;
     }
 
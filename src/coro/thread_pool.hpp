@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "utils/function_ref.hpp"
+#include "utils/spin_lock.hpp"
+
+// Thread indices, as used to pin coroutines to a thread (see `stage_info::on_main_thread`)
+inline constexpr std::uint32_t main_thread = 0; // the thread calling `thread_pool::run`, which is worker `0`
+inline constexpr std::uint32_t any_thread = ~std::uint32_t{};
+
+// Fixed set of worker threads for stages that opt in to parallel execution.
+// Every batch is split into one range of indices per thread; a thread takes work from the front of its own range, and when it runs dry it steals the back half of somebody else's.
+// The thread calling `run` takes part as worker `0`, and `run` only returns once the whole batch is done and every worker has taken part in it.
+struct thread_pool final
+{
+    using job = function_ref<void(std::size_t, std::uint32_t)>;
+
+    inline static std::uint32_t default_workers() noexcept
+    {
+        return std::max(std::thread::hardware_concurrency(), 1u) - 1;
+    }
+
+    inline explicit thread_pool(std::uint32_t workers = default_workers())
+        : ranges{new work_range[workers + 1]}
+    {
+        threads.reserve(workers);
+        for (std::uint32_t i{}; i < workers; ++i)
+            threads.emplace_back([this, i]
+                                 { loop(i + 1); });
+    }
+
+    thread_pool(thread_pool const &) = delete;
+    thread_pool &operator=(thread_pool const &) = delete;
+
+    thread_pool(thread_pool &&) = delete;
+    thread_pool &operator=(thread_pool &&) = delete;
+
+    inline ~thread_pool()
+    {
+        {
+            std::scoped_lock lk{m};
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (auto &&t : threads)
+            t.join();
+    }
+
+    // Index of the calling thread in its pool; `0` for any thread that is not a pool worker (eg. the main thread)
+    inline static std::uint32_t current_worker() noexcept { return worker_index; }
+
+    // Number of threads taking part in a batch, the caller included
+    [[nodiscard]]
+    inline std::uint32_t size() const noexcept { return std::uint32_t(threads.size() + 1); }
+
+    // Call `fn(i, worker)` for every `i` in `[0, count)`, spread across the pool.
+    // Before that, every thread calls `on_each(worker)` exactly once; use it for work that must stay on a specific thread.
+    inline void run(std::size_t count, job fn, function_ref<void(std::uint32_t)> on_each);
+
+private:
+    struct alignas(64) work_range final
+    {
+        spin_lock lock;
+        std::size_t begin = 0, end = 0;
+    };
+
+    inline bool pop_front(std::uint32_t self, std::size_t &item) noexcept
+    {
+        auto &&r = ranges[self];
+        std::scoped_lock lk{r.lock};
+        if (r.begin == r.end)
+            return false;
+
+        item = r.begin++;
+        return true;
+    }
+
+    // take the back half of the first non-empty range and make it our own
+    inline bool steal(std::uint32_t self, std::size_t &item) noexcept
+    {
+        auto const n = size();
+        for (std::uint32_t k = 1; k < n; ++k)
+        {
+            auto &&victim = ranges[(self + k) % n];
+
+            std::size_t first, last;
+            {
+                std::scoped_lock lk{victim.lock};
+                if (victim.begin == victim.end)
+                    continue;
+
+                first = victim.begin + (victim.end - victim.begin) / 2;
+                last = std::exchange(victim.end, first);
+            }
+
+            item = first;
+            if (first + 1 != last)
+            {
+                auto &&mine = ranges[self];
+                std::scoped_lock lk{mine.lock};
+                mine.begin = first + 1;
+                mine.end = last;
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+
+    inline void work(std::uint32_t self, job fn)
+    {
+        std::size_t item;
+        while (pop_front(self, item) || steal(self, item))
+            fn(item, self);
+    }
+
+    inline void loop(std::uint32_t index)
+    {
+        worker_index = index;
+
+        std::uint64_t seen = 0;
+        std::unique_lock lk{m};
+        while (true)
+        {
+            wake.wait(lk, [&]
+                      { return stopping || generation != seen; });
+            if (stopping)
+                return;
+
+            seen = generation;
+            auto const fn = *current;
+            auto const each = *current_each;
+
+            lk.unlock();
+            each(index);
+            work(index, fn);
+            lk.lock();
+
+            if (++finished == threads.size())
+                done.notify_one();
+        }
+    }
+
+    inline static thread_local std::uint32_t worker_index = 0;
+
+    std::unique_ptr<work_range[]> ranges;
+    std::vector<std::thread> threads;
+
+    // v-- guarded by `m`
+    std::mutex m;
+    std::condition_variable wake, done;
+    job const *current = nullptr;
+    function_ref<void(std::uint32_t)> const *current_each = nullptr;
+    std::uint64_t generation = 0;
+    std::size_t finished = 0;
+    bool stopping = false;
+};
+
+inline void thread_pool::run(std::size_t count, job fn, function_ref<void(std::uint32_t)> on_each)
+{
+    auto const n = size();
+    for (std::uint32_t i{}; i < n; ++i)
+    {
+        auto &&r = ranges[i];
+        std::scoped_lock lk{r.lock};
+        r.begin = count * i / n;
+        r.end = count * (i + 1) / n;
+    }
+
+    {
+        std::scoped_lock lk{m};
+        current = &fn;
+        current_each = &on_each;
+        finished = 0;
+        ++generation;
+    }
+    wake.notify_all();
+
+    on_each(0);
+    work(0, fn);
+
+    // every item is taken by now, but workers might still be resuming theirs, or not even have woken up for `on_each`
+    std::unique_lock lk{m};
+    done.wait(lk, [&]
+              { return finished == threads.size(); });
+}
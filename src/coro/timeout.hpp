@@ -8,7 +8,7 @@
 
 namespace detail
 {
-    // TODO: use an `event<>` instead but make it thread-safe
+    // TODO: use an `event<>` instead, now that they can be triggered from any thread
     inline auto timeout_coro(stage_info &stage, std::stop_token &out, Uint64 ms) -> fire_and_forget
     {
         std::stop_source stop;
@@ -18,6 +18,15 @@ namespace detail
 
         stop.request_stop();
     }
+
+    inline auto timeout_coro(stage_info &stage, std::stop_token &out, Uint64 ms, std::stop_token done) -> fire_and_forget
+    {
+        std::stop_source stop;
+        out = stop.get_token();
+
+        if (co_await stage.sleep(ms, std::move(done)))
+            stop.request_stop();
+    }
 }
 
 // Register a new task to timeout after the given time in ms and return a stop token to listen for timeout.
@@ -26,6 +35,11 @@ namespace detail
 // auto stop_token = timeout(sched, 1000); // timeout after 1 second
 // my_task(sched, stop_token); // spawn your task; check for stops inside the task
 // ```
+// NOTE: both overloads allocate a helper coroutine and a `std::stop_source`. To time out a single wait instead, `sleep` takes a stop token and allocates nothing:
+// ```cpp
+// if (!co_await stage.sleep(1000, stop)) // woken up as soon as `stop` is requested
+//     co_return;
+// ```
 [[nodiscard("You should use the token to check for timeout")]]
 inline auto timeout(stage_info &stage, Uint64 ms) -> std::stop_token
 {
@@ -33,3 +47,13 @@ inline auto timeout(stage_info &stage, Uint64 ms) -> std::stop_token
     detail::timeout_coro(stage, out, ms);
     return out;
 }
+
+// Same as above, but gives up as soon as `done` is requested (eg. by the task once it finished): the timer slot and the helper coroutine are freed right away, and the returned token never stops.
+// NOTE: still allocates, see above for `co_await stage.sleep(ms, stop)`
+[[nodiscard("You should use the token to check for timeout")]]
+inline auto timeout(stage_info &stage, Uint64 ms, std::stop_token done) -> std::stop_token
+{
+    std::stop_token out;
+    detail::timeout_coro(stage, out, ms, std::move(done));
+    return out;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "utils/intrusive_list.hpp"
+
+// Base for anything waiting on a `timer_wheel`; the wheel links the nodes but never allocates or owns them
+struct timer_node
+{
+    static constexpr std::uint8_t unlinked = 0xff;
+
+    std::uint64_t when;
+    timer_node *next = nullptr;
+
+    // v-- where the node is in the wheel, so that it can be taken out early (see `timer_wheel::remove`)
+    timer_node *prev = nullptr;
+    std::uint64_t tick = 0; // a tick its slot covers; the one it expires at on level 0
+    std::uint8_t level = unlinked;
+};
+
+using timer_list = intrusive_list<timer_node>;
+
+// Hierarchical timing wheel (see Varghese & Lauck) with 1 tick resolution.
+// Each level has 64 slots, and a slot at level `L` covers 64^L ticks; 4 levels cover ~2^24 ticks, timers further than that are parked on the last level until they get closer.
+// Insertion and removal are O(1), and every tick that has timers is expired by splicing its whole slot at once.
+// Timers of higher levels are pulled down ("cascaded") when the lower level wraps around.
+struct timer_wheel final
+{
+    static constexpr std::uint32_t slot_bits = 6;
+    static constexpr std::uint32_t slot_count = 1 << slot_bits;
+    static constexpr std::uint32_t level_count = 4;
+    static constexpr std::uint64_t slot_mask = slot_count - 1;
+    static constexpr std::uint64_t max_delta = (std::uint64_t(1) << (slot_bits * level_count)) - 1;
+    static constexpr std::uint64_t never = ~std::uint64_t{};
+
+    inline explicit timer_wheel(std::uint64_t now = 0) noexcept : current{now} {}
+
+    timer_wheel(timer_wheel const &) = delete;
+    timer_wheel &operator=(timer_wheel const &) = delete;
+
+    timer_wheel(timer_wheel &&) = default;
+    timer_wheel &operator=(timer_wheel &&) = default;
+
+    // Register `node` to be expired at tick `node.when`; timers in the past expire on the next `advance`.
+    // NOTE: `node` must stay alive until it expires or is removed
+    inline void insert(timer_node &node) noexcept
+    {
+        place(node);
+        ++count;
+    }
+
+    // Take `node` out before it expires, in O(1); returns `false` if it isn't in the wheel (anymore)
+    inline bool remove(timer_node &node) noexcept
+    {
+        // NOTE: timers only expire from level 0, and expiring doesn't touch the nodes, so the ones behind `current` are gone already
+        if (node.level == timer_node::unlinked || (node.level == 0 && node.tick < current))
+            return false;
+
+        auto const slot = (node.tick >> (slot_bits * node.level)) & slot_mask;
+        auto &&lv = levels[node.level];
+        auto &&list = lv.slots[slot];
+
+        if (node.prev)
+            node.prev->next = node.next;
+        else
+            list.first = node.next;
+
+        if (node.next)
+            node.next->prev = node.prev;
+        else
+            list.last = node.prev;
+
+        --list.size;
+        if (list.is_empty())
+            lv.occupied &= ~(std::uint64_t(1) << slot);
+
+        node.level = timer_node::unlinked;
+        --count;
+        return true;
+    }
+
+    // Move every timer due at or before `now` into `out`, keeping them ordered by tick
+    inline void advance(std::uint64_t now, timer_list &out) noexcept
+    {
+        while (current <= now)
+        {
+            if (count == 0)
+            {
+                current = now + 1;
+                break;
+            }
+
+            auto const slot = current & slot_mask;
+            if (slot == 0)
+                cascade();
+
+            // skip straight to the next non-empty slot of this lap, if it's due yet
+            auto const reach = std::min(now - current, slot_mask - slot);
+            if (auto const bits = levels[0].occupied >> slot; bits != 0)
+            {
+                auto const skip = std::uint64_t(std::countr_zero(bits));
+                if (skip <= reach)
+                {
+                    current += skip;
+                    expire(slot + skip, out);
+                    ++current;
+                    continue;
+                }
+            }
+
+            current += reach + 1;
+        }
+    }
+
+    // The earliest tick a timer can be due at, or `never` when there's none.
+    // Exact for the timers of the next 64 ticks; further ones are only known by their slot, so this is the start of the earliest slot
+    [[nodiscard]]
+    inline std::uint64_t next_due() const noexcept
+    {
+        if (count == 0)
+            return never;
+
+        auto due = never;
+        for (std::uint32_t lvl = 0; lvl < level_count; ++lvl)
+        {
+            auto &&lv = levels[lvl];
+            if (lv.occupied == 0)
+                continue;
+
+            // slots are laid out from the one `current` is in, wrapping around
+            auto const shift = slot_bits * lvl;
+            auto const slot = (current >> shift) & slot_mask;
+            auto occupied = lv.occupied;
+
+            // NOTE: on higher levels, the slot `current` is in is cascaded on its first tick; past that, whatever is in it is a full lap ahead
+            auto const lap_ahead = lvl > 0 && (current & ((std::uint64_t(1) << shift) - 1)) != 0;
+            if (lap_ahead)
+                occupied &= ~(std::uint64_t(1) << slot);
+
+            auto const ahead = occupied ? std::uint64_t(std::countr_zero(std::rotr(occupied, int(slot)))) : slot_count;
+
+            auto const start = ((current >> shift) + ahead) << shift;
+            due = std::min(due, std::max(start, current));
+        }
+
+        return due;
+    }
+
+    [[nodiscard]] constexpr std::size_t size() const noexcept { return count; }
+    [[nodiscard]] constexpr bool is_empty() const noexcept { return count == 0; }
+
+private:
+    struct level final
+    {
+        std::array<timer_list, slot_count> slots;
+        std::uint64_t occupied = 0; // bit `i` is set if `slots[i]` is not empty
+    };
+
+    inline void place(timer_node &node) noexcept
+    {
+        auto const when = std::max(node.when, current);
+        auto const delta = std::min(when - current, max_delta);
+
+        std::uint32_t lvl = 0;
+        while (lvl + 1 < level_count && delta >> (slot_bits * (lvl + 1)) != 0)
+            ++lvl;
+
+        // NOTE: far away timers are clamped to the last slot they can reach; they get placed again when cascaded
+        auto const slot = ((current + delta) >> (slot_bits * lvl)) & slot_mask;
+        auto &&list = levels[lvl].slots[slot];
+
+        node.prev = list.last;
+        node.tick = current + delta;
+        node.level = std::uint8_t(lvl);
+        list.push_one(node);
+        levels[lvl].occupied |= std::uint64_t(1) << slot;
+    }
+
+    // `current` has just wrapped level 0; bring the timers of the next slots down
+    inline void cascade() noexcept
+    {
+        for (std::uint32_t lvl = 1; lvl < level_count; ++lvl)
+        {
+            auto const slot = (current >> (slot_bits * lvl)) & slot_mask;
+
+            auto &&lv = levels[lvl];
+            auto list = std::exchange(lv.slots[slot], {});
+            lv.occupied &= ~(std::uint64_t(1) << slot);
+
+            while (auto node = list.pop())
+                place(*node);
+
+            if (slot != 0)
+                break;
+        }
+    }
+
+    inline void expire(std::uint64_t slot, timer_list &out) noexcept
+    {
+        auto &&lv = levels[0];
+        count -= lv.slots[slot].size;
+        out.splice(lv.slots[slot]);
+        lv.occupied &= ~(std::uint64_t(1) << slot);
+    }
+
+    std::array<level, level_count> levels{};
+    std::uint64_t current; // the next tick to expire
+    std::size_t count = 0;
+};
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <entt/container/dense_map.hpp>
+#include <SDL3/SDL_timer.h>
+#include "coro/profiler.hpp"
+#include "coro/trace_ring.hpp"
+
+// Streams traces to a Chrome Trace Event file (JSON array format), for chrome://tracing, Perfetto (ui.perfetto.dev) and friends.
+// Every stage shows up as a process and every thread as a track inside it; the queueing delay, the line and the coroutine ids go to the event arguments.
+// Arrows (flow events) link a coroutine to the one that started it, and to the one that woke it up (see `trace::parent` and `trace::waker`).
+// The file is written on a thread of its own: `collect` only copies the new traces into a bounded buffer, and drops them when the writer can't keep up.
+// NOTE: the closing `]` is written by the destructor, but the viewers also accept a file that was cut short
+struct trace_exporter final
+{
+    static constexpr std::size_t default_buffered = 64 * 1024; // traces
+
+    inline explicit trace_exporter(char const *path, std::size_t max_buffered = default_buffered)
+        : out{std::fopen(path, "w")}, max_pending{max_buffered}
+    {
+        if (!out)
+        {
+            std::printf("ERROR: couldn't open %s for the trace export.\n", path);
+            return;
+        }
+
+        std::fputs("[\n", out);
+        pending.reserve(max_pending);
+        writing.reserve(max_pending);
+
+        writer = std::thread{[this]
+                             { loop(); }};
+    }
+
+    trace_exporter(trace_exporter const &) = delete;
+    trace_exporter &operator=(trace_exporter const &) = delete;
+
+    trace_exporter(trace_exporter &&) = delete;
+    trace_exporter &operator=(trace_exporter &&) = delete;
+
+    // Writes what is still buffered, then closes the file
+    inline ~trace_exporter()
+    {
+        if (!out)
+            return;
+
+        {
+            std::scoped_lock lk{m};
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+
+        std::fputs("\n]\n", out);
+        std::fclose(out);
+    }
+
+    [[nodiscard]]
+    inline bool is_open() const noexcept { return out != nullptr; }
+
+    // What the process of `sid` is called in the viewer; the built-in stages are named already, the others show their id.
+    // NOTE: `name` must outlive the exporter
+    inline void name_stage(stage_id sid, std::string_view name)
+    {
+        std::scoped_lock lk{m};
+        stage_names.emplace_back(sid, name);
+    }
+
+    // Queue the traces pushed to `traces` since the last call; call it once per frame.
+    // Traces that left the ring in between are lost, as are those that don't fit in the buffer
+    inline void collect(trace_ring const &traces);
+
+    // traces that never made it to the file
+    [[nodiscard]]
+    inline std::uint64_t dropped() const noexcept
+    {
+        std::scoped_lock lk{m};
+        return n_dropped;
+    }
+
+private:
+    inline void loop();
+
+    // v-- writer thread only
+    inline std::uint32_t pid_of(stage_id sid, std::vector<std::pair<stage_id, std::string_view>> const &names);
+    inline std::uint32_t tid_of(std::uint32_t pid, std::thread::id tid);
+    inline void write(trace const &t, std::uint32_t pid, std::uint32_t tid);
+    inline void write_flows(trace const &t, std::uint32_t pid, std::uint32_t tid);
+
+    FILE *out;
+    std::size_t const max_pending;
+    std::uint64_t seen = 0; // `trace_ring::total` at the last `collect`
+
+    std::thread writer;
+
+    // v-- guarded by `m`
+    mutable std::mutex m;
+    std::condition_variable wake;
+    std::vector<trace> pending;
+    std::vector<std::pair<stage_id, std::string_view>> stage_names;
+    std::uint64_t n_dropped = 0;
+    bool stopping = false;
+
+    // v-- writer thread only
+    std::vector<trace> writing;
+    std::vector<stage_id> pids;                                    // index + 1 is the pid
+    std::vector<std::pair<std::uint32_t, std::thread::id>> tracks; // (pid, thread); index + 1 is the tid
+    std::vector<std::thread::id> threads;                          // in the order they showed up
+    bool first_event = true;
+
+    // the latest trace of each coroutine, where its arrows start from
+    struct slice final
+    {
+        std::uint32_t pid, tid;
+        Uint64 start;
+        coro_id parent;
+    };
+    entt::dense_map<coro_id, slice, coro_id_hash> last_slices;
+    std::uint64_t flow_count = 0;
+};
+
+inline void trace_exporter::collect(trace_ring const &traces)
+{
+    if (!out)
+        return;
+
+    auto const total = traces.total();
+    auto const oldest = total - traces.size();
+
+    auto const lost = oldest > seen ? oldest - seen : 0;
+    auto const first = std::max(seen, oldest) - oldest;
+    seen = total;
+
+    {
+        std::scoped_lock lk{m};
+
+        auto const room = max_pending - pending.size();
+        auto const count = traces.size() - first;
+        auto const last = first + std::min<std::size_t>(count, room);
+
+        traces.for_each(first, last, [&](trace const &t)
+                        { pending.push_back(t); });
+
+        n_dropped += lost + (count - (last - first));
+    }
+    wake.notify_one();
+}
+
+inline void trace_exporter::loop()
+{
+    std::vector<std::pair<stage_id, std::string_view>> names;
+
+    std::unique_lock lk{m};
+    while (true)
+    {
+        wake.wait(lk, [&]
+                  { return stopping || !pending.empty(); });
+        if (pending.empty() && stopping)
+            return;
+
+        std::swap(pending, writing);
+        names = stage_names;
+
+        lk.unlock();
+        for (auto &&t : writing)
+        {
+            auto const pid = pid_of(t.stage, names);
+            auto const tid = tid_of(pid, t.tid);
+            write(t, pid, tid);
+            write_flows(t, pid, tid);
+        }
+        writing.clear();
+        std::fflush(out);
+        lk.lock();
+    }
+}
+
+inline std::uint32_t trace_exporter::pid_of(stage_id sid, std::vector<std::pair<stage_id, std::string_view>> const &names)
+{
+    auto const it = std::find(pids.begin(), pids.end(), sid);
+    if (it != pids.end())
+        return std::uint32_t(it - pids.begin()) + 1;
+
+    pids.push_back(sid);
+    auto const pid = std::uint32_t(pids.size());
+
+    auto name = builtin_stage_name(sid);
+    for (auto &&[s, n] : names)
+    {
+        if (s == sid)
+            name = n;
+    }
+
+    std::fprintf(out, first_event ? "" : ",\n");
+    first_event = false;
+
+    if (name.empty())
+        std::fprintf(out, R"({"ph": "M", "name": "process_name", "pid": %u, "args": {"name": "stage %u"}})", pid, unsigned(sid));
+    else
+        std::fprintf(out, R"({"ph": "M", "name": "process_name", "pid": %u, "args": {"name": "%.*s"}})", pid, int(name.size()), name.data());
+
+    // list the stages in the order they first ran
+    std::fprintf(out, ",\n" R"({"ph": "M", "name": "process_sort_index", "pid": %u, "args": {"sort_index": %u}})", pid, pid);
+
+    return pid;
+}
+
+inline std::uint32_t trace_exporter::tid_of(std::uint32_t pid, std::thread::id tid)
+{
+    auto const key = std::pair{pid, tid};
+    auto const it = std::find(tracks.begin(), tracks.end(), key);
+    if (it != tracks.end())
+        return std::uint32_t(it - tracks.begin()) + 1;
+
+    tracks.push_back(key);
+    auto const index = std::uint32_t(tracks.size());
+
+    // the same thread has the same name in every stage
+    auto thread = std::find(threads.begin(), threads.end(), tid);
+    if (thread == threads.end())
+        thread = threads.insert(threads.end(), tid);
+
+    auto const thread_no = unsigned(thread - threads.begin());
+    std::fprintf(out, ",\n" R"({"ph": "M", "name": "thread_name", "pid": %u, "tid": %u, "args": {"name": "thread %u"}})", pid, index, thread_no);
+
+    return index;
+}
+
+inline void trace_exporter::write(trace const &t, std::uint32_t pid, std::uint32_t tid)
+{
+    auto const queued = t.start > t.wait_finish ? t.start - t.wait_finish : 0;
+    auto const waited = t.wait_finish > t.wait_start ? t.wait_finish - t.wait_start : 0;
+    auto const name = t.name();
+
+    // NOTE: function names don't have quotes or backslashes, so they go as is
+    std::fprintf(
+        out,
+        ",\n" R"({"ph": "X", "name": "%.*s", "pid": %u, "tid": %u, "ts": %.3f, "dur": %.3f, "args": {"line": %u, "queued_us": %.3f, "waited_us": %.3f, "coro": "%#llx", "parent": "%#llx", "waker": "%#llx"}})",
+        int(name.size()), name.data(), pid, tid,
+        double(t.start) / SDL_NS_PER_US, double(t.finish - t.start) / SDL_NS_PER_US,
+        unsigned(t.line()), double(queued) / SDL_NS_PER_US, double(waited) / SDL_NS_PER_US,
+        (unsigned long long)t.id, (unsigned long long)t.parent, (unsigned long long)t.waker //
+    );
+}
+
+inline void trace_exporter::write_flows(trace const &t, std::uint32_t pid, std::uint32_t tid)
+{
+    // an arrow from the latest trace of `from` to `t`; the viewers bind both ends to the slice around their timestamp
+    auto const arrow = [&](coro_id from, std::string_view name)
+    {
+        auto const it = last_slices.find(from);
+        if (it == last_slices.end())
+            return;
+
+        auto &&src = it->second;
+        auto const id = ++flow_count;
+        std::fprintf(
+            out, ",\n" R"({"ph": "s", "name": "%.*s", "cat": "flow", "id": %llu, "pid": %u, "tid": %u, "ts": %.3f})",
+            int(name.size()), name.data(), (unsigned long long)id, src.pid, src.tid, double(src.start) / SDL_NS_PER_US //
+        );
+        std::fprintf(
+            out, ",\n" R"({"ph": "f", "bp": "e", "name": "%.*s", "cat": "flow", "id": %llu, "pid": %u, "tid": %u, "ts": %.3f})",
+            int(name.size()), name.data(), (unsigned long long)id, pid, tid, double(t.start) / SDL_NS_PER_US //
+        );
+    };
+
+    if (t.id == 0)
+        return;
+
+    // NOTE: a coroutine is seen as new when its parent changes, since frames (hence ids) get reused
+    auto const it = last_slices.find(t.id);
+    if (t.parent != 0 && (it == last_slices.end() || it->second.parent != t.parent))
+        arrow(t.parent, "start");
+
+    if (t.flow != flow_kind::none && t.waker != 0)
+        arrow(t.waker, flow_name(t.flow));
+
+    last_slices.insert_or_assign(t.id, slice{.pid = pid, .tid = tid, .start = t.start, .parent = t.parent});
+}
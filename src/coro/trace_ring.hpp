@@ -0,0 +1,344 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <entt/container/dense_map.hpp>
+#include <SDL3/SDL_timer.h>
+#include "coro/profiler.hpp"
+
+// Bounded history of the traces, so that long sessions don't grow without bounds; the oldest traces are dropped first.
+// The memory is only taken as traces come in, up to the ceiling given to `set_capacity`.
+// Every trace is packed into 32 bytes: the times are deltas from the start of its frame, and the thread, stage and coroutines are ids into tables.
+// Reading gives back a whole `trace`.
+// NOTE: not thread-safe; the scheduler pushes from the thread running the frame
+struct trace_ring final
+{
+    static constexpr std::size_t default_bytes = 64 * 1024 * 1024;
+
+    inline explicit trace_ring(std::size_t max_bytes = default_bytes)
+    {
+        set_capacity(max_bytes);
+    }
+
+    // Keep at most about `max_bytes` of traces (the id tables aside); drops everything recorded so far and gives its memory back
+    inline void set_capacity(std::size_t max_bytes);
+
+    // Encode the traces pushed from now on relative to `start` (ns).
+    // NOTE: optional, a trace that can't be encoded relative to the current frame starts a new one
+    inline void begin_frame(Uint64 start);
+
+    inline void push(trace const &t);
+
+    inline void push(std::span<trace const> ts)
+    {
+        for (auto &&t : ts)
+            push(t);
+    }
+
+    [[nodiscard]]
+    inline std::size_t size() const noexcept { return std::size_t(head - tail); }
+
+    [[nodiscard]]
+    inline bool empty() const noexcept { return head == tail; }
+
+    // traces pushed since the start, the ones dropped included
+    [[nodiscard]]
+    inline std::uint64_t total() const noexcept { return head; }
+
+    [[nodiscard]]
+    inline std::size_t memory_bytes() const noexcept
+    {
+        return entries.capacity() * sizeof(entry) + marks.capacity() * sizeof(frame_mark);
+    }
+
+    // `i`-th oldest trace still in the ring
+    [[nodiscard]]
+    inline trace operator[](std::size_t i) const
+    {
+        auto const seq = tail + i;
+        return decode(entries[seq % entries.size()], mark_of(seq));
+    }
+
+    // Index of the first trace starting at or after `time`, or `size()`.
+    // NOTE: assumes the traces were pushed in start order, which `scheduler` does frame after frame
+    [[nodiscard]]
+    inline std::size_t lower_bound(Uint64 time) const;
+
+    // Call `fn(trace const &)` for the traces `[first, last)`, oldest first; cheaper than indexing one by one
+    template <typename Fn>
+    inline void for_each(std::size_t first, std::size_t last, Fn &&fn) const;
+
+private:
+    struct entry final
+    {
+        std::uint16_t site;           // see `suspend_sites`; the ids past 65535 share the last one
+        std::uint8_t thread;          // index into `threads`
+        std::uint8_t stage;           // index into `stages`
+        std::uint32_t start;          // ns since the start of the frame
+        std::uint32_t duration;       // ns
+        std::uint32_t queued;         // ns, from `wait_finish` to `start`
+        std::uint32_t waited_us : 30; // us, from `wait_start` to `wait_finish`; coarser, since sleeps can be long
+        std::uint32_t flow : 2;       // `flow_kind`
+        std::uint32_t coro;           // index into `coros`, as are the next two
+        std::uint32_t parent;
+        std::uint32_t waker;
+    };
+    static_assert(sizeof(entry) == 32);
+
+    struct frame_mark final
+    {
+        Uint64 base;         // ns
+        std::uint64_t first; // sequence number of the first trace of the frame
+    };
+
+    inline static std::uint32_t saturate(Uint64 v) noexcept
+    {
+        return std::uint32_t(std::min<Uint64>(v, std::numeric_limits<std::uint32_t>::max()));
+    }
+
+    static constexpr std::uint32_t max_waited_us = (1u << 30) - 1; // ~18 minutes
+
+    inline static Uint64 minus(Uint64 lhs, Uint64 rhs) noexcept { return lhs > rhs ? lhs - rhs : 0; }
+
+    [[nodiscard]]
+    inline frame_mark const &mark_at(std::uint64_t seq) const noexcept { return marks[seq % marks.size()]; }
+
+    // the newest frame starting at or before the trace `seq`
+    [[nodiscard]]
+    inline std::uint64_t mark_index_of(std::uint64_t seq) const noexcept
+    {
+        auto lo = mark_tail, hi = mark_head;
+        while (hi - lo > 1)
+        {
+            auto const mid = lo + (hi - lo) / 2;
+            if (mark_at(mid).first <= seq)
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        return lo;
+    }
+
+    [[nodiscard]]
+    inline frame_mark const &mark_of(std::uint64_t seq) const noexcept { return mark_at(mark_index_of(seq)); }
+
+    [[nodiscard]]
+    inline trace decode(entry const &e, frame_mark const &m) const
+    {
+        auto const start = m.base + e.start;
+        auto const wait_finish = start - e.queued;
+
+        return {
+            .site = e.site,
+            .stage = stages[e.stage],
+            .tid = threads[e.thread],
+            .wait_start = wait_finish - Uint64(e.waited_us) * SDL_NS_PER_US,
+            .wait_finish = wait_finish,
+            .start = start,
+            .finish = start + e.duration,
+            .id = coros[e.coro],
+            .parent = coros[e.parent],
+            .waker = coros[e.waker],
+            .flow = flow_kind(e.flow),
+        };
+    }
+
+    // small tables, looked up linearly; ids past the last one share it
+    template <typename T>
+    inline static std::uint8_t small_id(std::vector<T> &table, T const &value)
+    {
+        auto const it = std::find(table.begin(), table.end(), value);
+        if (it != table.end())
+            return std::uint8_t(it - table.begin());
+
+        if (table.size() > std::numeric_limits<std::uint8_t>::max())
+            return std::numeric_limits<std::uint8_t>::max();
+
+        table.push_back(value);
+        return std::uint8_t(table.size() - 1);
+    }
+
+    inline std::uint32_t coro_index(coro_id id);
+
+    // Store `val` at `seq`, growing `ring` up to `max` first; until it's full, `seq` is its size
+    template <typename T>
+    inline static void store(std::vector<T> &ring, std::size_t max, std::uint64_t seq, T const &val)
+    {
+        if (ring.size() == max)
+        {
+            ring[seq % max] = val;
+            return;
+        }
+
+        if (ring.size() == ring.capacity())
+            ring.reserve(std::min(max, std::max<std::size_t>(ring.size() * 2, 1024)));
+        ring.push_back(val);
+    }
+
+    inline void drop_oldest() noexcept
+    {
+        ++tail;
+
+        // forget the frames that have no trace left
+        while (mark_head - mark_tail > 1 && mark_at(mark_tail + 1).first <= tail)
+            ++mark_tail;
+    }
+
+    // v-- rings, growing up to their max size; `head` is the sequence number of the next one pushed, `tail` of the oldest one kept
+    std::vector<entry> entries;
+    std::size_t max_entries = 1;
+    std::uint64_t head = 0, tail = 0;
+
+    std::vector<frame_mark> marks;
+    std::size_t max_marks = 2;
+    std::uint64_t mark_head = 0, mark_tail = 0;
+
+    // v-- interned, never shrink
+    std::vector<std::thread::id> threads;
+    std::vector<stage_id> stages;
+
+    // NOTE: frames are pooled, so the same few addresses keep coming back; 0 (none) is always the first one
+    std::vector<coro_id> coros{0};
+    entt::dense_map<coro_id, std::uint32_t, coro_id_hash> coro_indices;
+};
+
+inline void trace_ring::set_capacity(std::size_t max_bytes)
+{
+    // 7/8th for the traces; even at a handful of traces per frame, the frames run out last
+    max_entries = std::max<std::size_t>(max_bytes / 8 * 7 / sizeof(entry), 1);
+    max_marks = std::max<std::size_t>(max_bytes / 8 / sizeof(frame_mark), 2);
+
+    entries = {};
+    marks = {};
+
+    head = tail = 0;
+    mark_head = mark_tail = 0;
+}
+
+inline void trace_ring::begin_frame(Uint64 start)
+{
+    // nothing refers to an empty frame yet, just move it
+    if (mark_head != mark_tail)
+    {
+        auto &&last = marks[(mark_head - 1) % marks.size()];
+        if (last.first == head)
+        {
+            last.base = start;
+            return;
+        }
+    }
+
+    if (mark_head - mark_tail == max_marks)
+    {
+        // the oldest frame goes, along with its traces
+        ++mark_tail;
+        tail = std::max(tail, mark_at(mark_tail).first);
+    }
+
+    store(marks, max_marks, mark_head, frame_mark{.base = start, .first = head});
+    ++mark_head;
+}
+
+inline std::uint32_t trace_ring::coro_index(coro_id id)
+{
+    if (id == 0)
+        return 0;
+
+    if (auto const it = coro_indices.find(id); it != coro_indices.end())
+        return it->second;
+
+    auto const index = std::uint32_t(coros.size());
+    coros.push_back(id);
+    coro_indices.emplace(id, index);
+    return index;
+}
+
+inline void trace_ring::push(trace const &t)
+{
+    auto need_frame = mark_head == mark_tail;
+    if (!need_frame)
+    {
+        auto const base = marks[(mark_head - 1) % marks.size()].base;
+        need_frame = t.start < base || t.start - base > std::numeric_limits<std::uint32_t>::max();
+    }
+
+    if (need_frame)
+        begin_frame(t.start);
+
+    if (head - tail == max_entries)
+        drop_oldest();
+
+    auto const base = marks[(mark_head - 1) % marks.size()].base;
+    store(entries, max_entries, head, entry{
+        .site = std::uint16_t(std::min<std::uint32_t>(t.site, std::numeric_limits<std::uint16_t>::max())),
+        .thread = small_id(threads, t.tid),
+        .stage = small_id(stages, t.stage),
+        .start = std::uint32_t(t.start - base),
+        .duration = saturate(minus(t.finish, t.start)),
+        .queued = saturate(minus(t.start, t.wait_finish)),
+        .waited_us = std::min<std::uint32_t>(saturate(minus(t.wait_finish, t.wait_start) / SDL_NS_PER_US), max_waited_us),
+        .flow = std::uint32_t(t.flow),
+        .coro = coro_index(t.id),
+        .parent = coro_index(t.parent),
+        .waker = coro_index(t.waker),
+    });
+    ++head;
+}
+
+inline std::size_t trace_ring::lower_bound(Uint64 time) const
+{
+    // frames first, then the traces of the frame; both are in start order
+    auto lo = mark_tail, hi = mark_head;
+    while (lo != hi)
+    {
+        auto const mid = lo + (hi - lo) / 2;
+        if (mark_at(mid).base < time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    // the traces of the frame before can still start after `time`
+    auto first = lo == mark_tail ? tail : std::max(tail, mark_at(lo - 1).first);
+    auto last = lo == mark_head ? head : std::max(tail, mark_at(lo).first);
+
+    while (first != last)
+    {
+        auto const mid = first + (last - first) / 2;
+        auto const &e = entries[mid % entries.size()];
+        if (mark_of(mid).base + e.start < time)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+
+    return std::size_t(first - tail);
+}
+
+template <typename Fn>
+inline void trace_ring::for_each(std::size_t first, std::size_t last, Fn &&fn) const
+{
+    last = std::min(last, size());
+    if (first >= last)
+        return;
+
+    auto seq = tail + first;
+    auto const end = tail + last;
+
+    auto m = mark_index_of(seq);
+    for (; seq != end; ++seq)
+    {
+        // move on to the frame of `seq`, skipping the empty ones
+        while (m + 1 != mark_head && mark_at(m + 1).first <= seq)
+            ++m;
+
+        fn(decode(entries[seq % entries.size()], mark_at(m)));
+    }
+}
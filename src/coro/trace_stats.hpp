@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <SDL3/SDL_timer.h>
+#include "coro/profiler.hpp"
+#include "coro/trace_ring.hpp"
+
+// Log-scale histogram of durations in ns: exact below 16ns, then 8 buckets per power of two, so any percentile is off by at most 12.5%.
+// Fixed size, adding and removing a value never allocates.
+struct duration_histogram final
+{
+    static constexpr std::size_t exact = 16;
+    static constexpr std::size_t sub_bits = 3;
+    static constexpr std::size_t bucket_count = exact + (64 - std::bit_width(exact - 1)) * (1 << sub_bits);
+
+    inline static std::size_t bucket_of(Uint64 v) noexcept
+    {
+        if (v < exact)
+            return std::size_t(v);
+
+        auto const e = std::size_t(std::bit_width(v)) - 1; // >= 4
+        auto const sub = std::size_t(v >> (e - sub_bits)) & ((1 << sub_bits) - 1);
+        return exact + (e - std::bit_width(exact - 1)) * (1 << sub_bits) + sub;
+    }
+
+    // the highest value that falls in `bucket`
+    inline static Uint64 upper_bound_of(std::size_t bucket) noexcept
+    {
+        if (bucket < exact)
+            return bucket;
+
+        auto const e = (bucket - exact) / (1 << sub_bits) + std::bit_width(exact - 1);
+        auto const sub = (bucket - exact) % (1 << sub_bits);
+        auto const lower = (Uint64(1) << e) | (Uint64(sub) << (e - sub_bits));
+        return lower + (Uint64(1) << (e - sub_bits)) - 1;
+    }
+
+    inline void add(Uint64 v) noexcept
+    {
+        ++counts[bucket_of(v)];
+        ++total;
+    }
+
+    // NOTE: `v` must have been added before
+    inline void remove(Uint64 v) noexcept
+    {
+        --counts[bucket_of(v)];
+        --total;
+    }
+
+    // `p` in [0, 100]; 0 when empty
+    [[nodiscard]]
+    inline Uint64 percentile(double p) const noexcept
+    {
+        if (total == 0)
+            return 0;
+
+        auto const rank = std::max<std::uint64_t>(std::uint64_t(p / 100.0 * double(total) + 0.5), 1);
+        std::uint64_t seen = 0;
+        for (std::size_t b{}; b < bucket_count; ++b)
+        {
+            seen += counts[b];
+            if (seen >= rank)
+                return upper_bound_of(b);
+        }
+
+        return upper_bound_of(bucket_count - 1);
+    }
+
+    std::array<std::uint64_t, bucket_count> counts{};
+    std::uint64_t total = 0;
+};
+
+// Statistics per suspend point (function + line), kept up to date as traces come in; nothing is ever rescanned.
+// Also keeps a rolling window of frame times for a graph with percentile lines.
+struct trace_stats final
+{
+    static constexpr std::size_t frame_window = 300; // ~5s at 60 FPS
+
+    struct site_stats final
+    {
+        std::string_view name;
+        uint_least32_t line;
+
+        std::uint64_t count = 0;
+        Uint64 total = 0, max = 0; // ns
+        duration_histogram durations;
+
+        [[nodiscard]]
+        inline Uint64 mean() const noexcept { return count ? total / count : 0; }
+    };
+
+    // Add the traces pushed to `traces` since the last call; the ones that left the ring in between are skipped
+    inline void collect(trace_ring const &traces)
+    {
+        auto const oldest = traces.total() - traces.size();
+        auto const first = std::max(seen, oldest) - oldest;
+        seen = traces.total();
+
+        traces.for_each(first, traces.size(), [&](trace const &t)
+                        { add(t); });
+    }
+
+    inline void add(trace const &t);
+
+    inline void add_frame(Uint64 wall)
+    {
+        if (frame_count == frame_window)
+            window.remove(frame_times[frame_next]);
+        else
+            ++frame_count;
+
+        frame_times[frame_next] = wall;
+        frame_next = (frame_next + 1) % frame_window;
+        window.add(wall);
+    }
+
+    [[nodiscard]]
+    inline std::span<site_stats const> sites() const noexcept { return per_site; }
+
+    // how many frames are in the window, and the `i`-th oldest of them
+    [[nodiscard]]
+    inline std::size_t frames() const noexcept { return frame_count; }
+
+    [[nodiscard]]
+    inline Uint64 frame_time(std::size_t i) const noexcept
+    {
+        return frame_times[(frame_next + frame_window - frame_count + i) % frame_window];
+    }
+
+    // over the frames in the window
+    [[nodiscard]]
+    inline Uint64 frame_percentile(double p) const noexcept { return window.percentile(p); }
+
+private:
+    static constexpr std::uint32_t unseen = ~std::uint32_t{};
+
+    std::vector<site_stats> per_site;    // in the order they showed up
+    std::vector<std::uint32_t> index_of; // by `trace::site`; index into `per_site`, or `unseen`
+    std::uint64_t seen = 0; // `trace_ring::total` at the last `collect`
+
+    std::array<Uint64, frame_window> frame_times{};
+    std::size_t frame_next = 0, frame_count = 0;
+    duration_histogram window;
+};
+
+inline void trace_stats::add(trace const &t)
+{
+    if (t.site >= index_of.size())
+        index_of.resize(t.site + 1, unseen);
+
+    auto &&index = index_of[t.site];
+    if (index == unseen)
+    {
+        index = std::uint32_t(per_site.size());
+        per_site.push_back({.name = t.name(), .line = t.line()});
+    }
+
+    auto &&s = per_site[index];
+    auto const duration = t.finish - t.start;
+
+    ++s.count;
+    s.total += duration;
+    s.max = std::max(s.max, duration);
+    s.durations.add(duration);
+}
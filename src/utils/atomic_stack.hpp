@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+#include "utils/intrusive_list.hpp"
+
+// Lock-free LIFO of nodes that link themselves through a `Node *next` member, for pushing from any thread; nothing is allocated.
+// Nodes only come out all at once (`take_all`), so there is no ABA problem.
+// Pushing and taking synchronize both ways: whatever a thread did before either is visible to the other thread after its own.
+// NOTE: the stack doesn't own the nodes; they must outlive their time in the stack
+template <typename Node>
+struct atomic_stack final
+{
+    atomic_stack() = default;
+
+    atomic_stack(atomic_stack const &) = delete;
+    atomic_stack &operator=(atomic_stack const &) = delete;
+
+    // NOTE: moving gives a fresh, empty stack, so that the owner stays movable; never move while it isn't empty
+    inline atomic_stack(atomic_stack &&) noexcept {}
+    inline atomic_stack &operator=(atomic_stack &&) noexcept { return *this; }
+
+    inline void push_one(Node &node) noexcept { push_chain(node, node); }
+
+    // Push the nodes from `first` to `last`, already linked through `next`, in one go; `first` ends up on top
+    inline void push_chain(Node &first, Node &last) noexcept
+    {
+        auto top = head.load(std::memory_order_relaxed);
+        do
+            last.next = top;
+        while (!head.compare_exchange_weak(top, &first, std::memory_order_acq_rel, std::memory_order_relaxed));
+    }
+
+    // Every node pushed so far, the last one first, linked through `next`; the stack is left empty
+    [[nodiscard]]
+    inline Node *take_all() noexcept { return head.exchange(nullptr, std::memory_order_acq_rel); }
+
+    // Same as `take_all`, but in the order they were pushed
+    [[nodiscard]]
+    inline intrusive_list<Node> take_all_fifo() noexcept
+    {
+        Node *reversed = nullptr;
+        for (auto node = take_all(); node;)
+        {
+            auto const next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+        }
+
+        intrusive_list<Node> out;
+        while (reversed)
+            out.push_one(*std::exchange(reversed, reversed->next));
+
+        return out;
+    }
+
+    [[nodiscard]]
+    inline bool is_empty() const noexcept { return !head.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<Node *> head = nullptr;
+};
@@ -1,26 +1,93 @@
-
 #pragma once
 
 #include <string_view>
 
+// Short name of a function out of `std::source_location::function_name()`: no return type, calling convention nor parameters.
+// Scope and template arguments stay, eg. `void __cdecl ns::foo<int>(float)` (MSVC) and `void ns::foo(float) [with T = int]` (GCC) give `ns::foo<int>` and `ns::foo`.
+// Functions returning function pointers work too, eg. `void (* get())(int)` gives `get`.
+// NOTE: scans the whole string, so cache the result (see `suspend_sites`)
 inline std::string_view trim_func_name(char const *func_name) noexcept
 {
-#ifndef _MSC_VER
-#warning \
-    "Short function names only work on MSVC for now, on other compilers it will return the full string, untrimmed.\n" \
-    "If you know how std::source_location reports function_name() on other compilers, please submit a PR."
+    std::string_view const full = func_name;
+
+    // GCC and Clang append the template arguments after the parameters, eg. `[with T = int]` or `[T = int]`
+    auto end = full.size();
+    if (full.ends_with(']'))
+        end = full.rfind(" [");
+
+    // GCC doesn't give the parameters of lambdas, eg. `main()::<lambda(int)>`
+    if (full.substr(0, end).ends_with('>'))
+        return full.substr(0, end);
+
+    // where the parenthesized part closing at `close` opens, or `npos`
+    auto const open_of = [&](std::size_t close)
+    {
+        int depth = 0;
+        auto open = close + 1;
+        while (open-- != 0)
+        {
+            if (full[open] == ')')
+                ++depth;
+            else if (full[open] == '(' && --depth == 0)
+                break;
+        }
+
+        return open;
+    };
+
+    // the parameters are the last parenthesized part (`const`, `noexcept` and such can follow)
+    auto const close = full.rfind(')', end);
+    if (close == std::string_view::npos)
+        return full;
+
+    auto open = open_of(close);
+    if (open == std::string_view::npos || open == 0)
+        return full;
+
+    // a function returning a function pointer: the parameters are those of the pointer, and the function is declared in the parentheses before them, eg. `void (* get())(int)`
+    // NOTE: `operator ()` is followed by parameters too, but its parentheses are empty
+    std::size_t declarator = 0; // where the parentheses of the function open, if any
+    while (full[open - 1] == ')')
+    {
+        auto const outer = open_of(open - 1);
+        if (outer == std::string_view::npos || outer + 1 == open - 1)
+            break;
 
-    return func_name;
-#endif
+        auto const inner = full.rfind(')', open - 2);
+        if (inner == std::string_view::npos || inner <= outer)
+            break;
 
-#define start_str "__cdecl "
+        declarator = outer + 1;
+        open = open_of(inner);
+        if (open == std::string_view::npos || open <= outer)
+            return full;
+    }
 
-    auto start = strstr(func_name, start_str);
-    start += std::size(start_str) - 1; // - 1 because of the '\0'
+    // the name goes back to the first space outside of brackets, or the pointer in a declarator
+    int depth = 0;
+    auto start = open;
+    while (start > declarator)
+    {
+        auto const c = full[start - 1];
+        if (c == ')' || c == '>')
+            ++depth;
+        else if (c == '(' || c == '<')
+            --depth;
+        else if ((c == '*' || c == '&') && declarator != 0 && depth <= 0)
+            break;
+        else if (c == ' ' && depth <= 0)
+        {
+            // MSVC writes `operator ()`
+            constexpr std::string_view op = "operator";
+            if (!full.substr(0, start - 1).ends_with(op))
+                break;
 
-    auto end = strchr(start, '(');
+            start -= op.size() + 1;
+            continue;
+        }
 
-    return std::string_view{start, end};
+        --start;
+    }
 
-#undef start_str
-}
\ No newline at end of file
+    return full.substr(start, open - start);
+}
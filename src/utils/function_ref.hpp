@@ -13,7 +13,7 @@ struct function_ref<R(Args...)> final
         requires(std::is_invocable_r_v<R, Func, Args...> //
                  and !std::is_same_v<std::remove_cvref_t<Func>, function_ref>)
     inline function_ref(Func &&fn)
-        : func{&fn}, impl{&call_impl<Func>}
+        : func{&fn}, impl{&call_impl<std::remove_reference_t<Func>>}
     {
     }
 
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+
+// FIFO of nodes that link themselves through a `Node *next` member; nothing is allocated, and appending a whole list is O(1).
+// NOTE: the list doesn't own the nodes; they must outlive their time in the list
+template <typename Node>
+struct intrusive_list final
+{
+    Node *first = nullptr, *last = nullptr;
+    std::size_t size = 0;
+
+    constexpr void push_one(Node &node) noexcept
+    {
+        node.next = nullptr;
+        if (last)
+            last->next = &node;
+        else
+            first = &node;
+
+        last = &node;
+        ++size;
+    }
+
+    constexpr void splice(intrusive_list &other) noexcept
+    {
+        if (other.is_empty())
+            return;
+
+        if (last)
+            last->next = other.first;
+        else
+            first = other.first;
+
+        last = other.last;
+        size += other.size;
+        other = {};
+    }
+
+    [[nodiscard]]
+    constexpr Node *pop() noexcept
+    {
+        auto node = first;
+        if (node)
+        {
+            first = node->next;
+            if (!first)
+                last = nullptr;
+            --size;
+        }
+        return node;
+    }
+
+    [[nodiscard]] constexpr bool is_empty() const noexcept { return !first; }
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+// Lock for very short critical sections, like pushing to a queue.
+// Satisfies Lockable so it works with `std::scoped_lock`.
+struct spin_lock final
+{
+    spin_lock() = default;
+
+    spin_lock(spin_lock const &) = delete;
+    spin_lock &operator=(spin_lock const &) = delete;
+
+    // NOTE: moving gives a fresh, unlocked lock, so that the owner stays movable; never move while the lock is held
+    inline spin_lock(spin_lock &&) noexcept {}
+    inline spin_lock &operator=(spin_lock &&) noexcept { return *this; }
+
+    inline void lock() noexcept
+    {
+        while (flag.test_and_set(std::memory_order_acquire))
+        {
+            while (flag.test(std::memory_order_relaxed))
+                std::this_thread::yield();
+        }
+    }
+
+    [[nodiscard]]
+    inline bool try_lock() noexcept { return !flag.test_and_set(std::memory_order_acquire); }
+
+    inline void unlock() noexcept { flag.clear(std::memory_order_release); }
+
+private:
+    std::atomic_flag flag;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <source_location>
+
+// Minimal harness for the headless tests; a failed `check` is printed and makes the test executable exit with 1 (see main.cpp).
+
+inline std::atomic<std::size_t> failed_checks{0};
+
+// NOTE: thread-safe, so that coroutines running on workers can check too
+inline bool check(bool ok, char const *what, std::source_location const &sl = std::source_location::current())
+{
+    if (!ok)
+    {
+        std::printf("ERROR: %s:%u: %s\n", sl.file_name(), unsigned(sl.line()), what);
+        failed_checks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return ok;
+}
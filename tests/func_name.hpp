@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string_view>
+
+#include "utils/func_name.hpp"
+#include "check.hpp"
+
+// `trim_func_name` on what `std::source_location::function_name()` gives with GCC, Clang and MSVC
+
+namespace func_name_test
+{
+    inline bool trims_to(char const *func_name, std::string_view expected) { return trim_func_name(func_name) == expected; }
+
+    inline void run()
+    {
+        // GCC
+        check(trims_to("void ns::foo(float) [with T = int]", "ns::foo"), "GCC template");
+        check(trims_to("void S::operator()(int) const", "S::operator()"), "GCC call operator");
+        check(trims_to("S& S::operator*()", "S::operator*"), "GCC operator returning a reference");
+        check(trims_to("int* S::ptr(int (*)(char))", "S::ptr"), "GCC function pointer parameter");
+        check(trims_to("main()::<lambda(int)>", "main()::<lambda(int)>"), "GCC lambda");
+        check(trims_to("void (* get())(int)", "get"), "GCC function returning a function pointer");
+        check(trims_to("void (* ns::get(T))(int) [with T = float]", "ns::get"), "GCC template returning a function pointer");
+        check(trims_to("void (* (* nested())(char))(int)", "nested"), "GCC function returning a pointer to a function returning a function pointer");
+
+        // Clang
+        check(trims_to("void (*get())(int)", "get"), "Clang function returning a function pointer");
+
+        // MSVC
+        check(trims_to("void __cdecl ns::foo<int>(float)", "ns::foo<int>"), "MSVC template");
+        check(trims_to("void __cdecl S::operator ()(int) const", "S::operator ()"), "MSVC call operator");
+        check(trims_to("void (__cdecl *__cdecl get(void))(int)", "get"), "MSVC function returning a function pointer");
+    }
+}
@@ -0,0 +1,28 @@
+#include <cstdio>
+
+#include "check.hpp"
+#include "func_name.hpp"
+#include "scheduler.hpp"
+#include "stages.hpp"
+#include "sync.hpp"
+
+// Headless tests for the coroutine runtime; no window or renderer is created.
+// Usage: coro_tests
+// Exits with 1 if any check failed, see check.hpp.
+
+int main()
+{
+    func_name_test::run();
+    stages_test::run();
+    scheduler_test::run();
+    sync_test::run();
+
+    if (auto const failed = failed_checks.load(); failed != 0)
+    {
+        std::printf("%zu checks failed\n", failed);
+        return 1;
+    }
+
+    std::printf("all checks passed\n");
+    return 0;
+}
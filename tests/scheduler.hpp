@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+#include "coro/scheduler.hpp"
+#include "check.hpp"
+
+// `scheduler::run_frame` running independent stages at the same time on a pool: `stage_thread::main` stages stay on the calling thread,
+// `stage_thread::any` ones go wherever, and a stage still only starts once its dependencies are done.
+
+namespace scheduler_test
+{
+    inline constexpr stage_id on_main = stage_id{100}, anywhere = stage_id{101}, also_anywhere = stage_id{102}, last = stage_id{103};
+    inline constexpr std::size_t frames = 50;
+    inline constexpr std::size_t per_stage = 100;
+
+    struct counts final
+    {
+        std::atomic<std::size_t> main, any, also_any;
+    };
+
+    inline auto count_on(stage_info &s, std::atomic<std::size_t> &n, std::thread::id main_id, bool must_be_main) -> fire_and_forget
+    {
+        while (true)
+        {
+            co_await s.sched();
+            if (must_be_main)
+                check(std::this_thread::get_id() == main_id, "main stages run on the thread calling run_frame");
+
+            n.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // runs after the three others, so it sees all of their work of the frame
+    inline auto count_after(stage_info &s, counts const &c, std::size_t &frame) -> fire_and_forget
+    {
+        while (true)
+        {
+            co_await s.sched();
+            ++frame;
+
+            auto const expected = frame * per_stage;
+            check(c.main.load() == expected && c.any.load() == expected && c.also_any.load() == expected,
+                  "a stage starts once its dependencies are done");
+        }
+    }
+
+    inline void run_concurrent_stages()
+    {
+        scheduler sched;
+        context ctx;
+        thread_pool pool{3};
+
+        sched.frame_stage(on_main, stage_thread::main);
+        sched.frame_stage(anywhere, stage_thread::any);
+        sched.frame_stage(also_anywhere, stage_thread::any);
+        sched.run_after(last, on_main);
+        sched.run_after(last, anywhere);
+        sched.run_after(last, also_anywhere);
+
+        counts c{};
+        auto const main_id = std::this_thread::get_id();
+        for (std::size_t i{}; i < per_stage; ++i)
+        {
+            count_on(sched.stages[on_main], c.main, main_id, true);
+            count_on(sched.stages[anywhere], c.any, main_id, false);
+            count_on(sched.stages[also_anywhere], c.also_any, main_id, false);
+        }
+
+        std::size_t frame = 0;
+        count_after(sched.stages[last], c, frame);
+
+        for (std::size_t f{}; f < frames; ++f)
+            sched.run_frame(ctx, &pool);
+
+        check(frame == frames, "every stage runs once per frame");
+        check(ctx.stage_times.size() == 4, "every frame stage is timed");
+    }
+
+    inline void run()
+    {
+        run_concurrent_stages();
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <stop_token>
+#include <vector>
+
+#include "coro/stage.hpp"
+#include "check.hpp"
+
+// `stage_info` resuming more ready coroutines in one run than a chain of transfers could fit on the stack, see `stage_info::max_transfers`.
+// Then what `sleep(ms, stop)` gives, depending on when the stop comes.
+// NOTE: meant for unoptimized builds too, which don't turn the transfers into tail calls
+
+namespace stages_test
+{
+    inline constexpr std::size_t many = 1'000'000;
+    inline constexpr std::size_t runs = 3;
+
+    inline auto spin(stage_info &s, std::size_t &done) -> fire_and_forget
+    {
+        for (std::size_t i{}; i < runs; ++i)
+            co_await s.sched();
+
+        ++done;
+    }
+
+    inline void run_many_ready()
+    {
+        stage_info s;
+        std::vector<trace> traces;
+        std::size_t done = 0;
+
+        for (std::size_t i{}; i < many; ++i)
+            spin(s, done);
+
+        for (std::size_t r{}; r < runs; ++r)
+        {
+            traces.clear();
+            s.run_into(SDL_GetTicksNS(), traces);
+        }
+
+        check(done == many, "every ready coroutine finishes");
+    }
+
+    // 1 if the time ran out, 0 if stopped
+    inline auto sleep_until_stopped(stage_info &s, Uint64 ms, std::stop_token stop, int &out) -> fire_and_forget
+    {
+        out = co_await s.sleep(ms, std::move(stop));
+    }
+
+    inline auto stop_on_next_run(stage_info &s, std::stop_source &src) -> fire_and_forget
+    {
+        co_await s.sched();
+        src.request_stop();
+    }
+
+    inline void run_stoppable_sleep()
+    {
+        std::vector<trace> traces;
+        auto const now = SDL_GetTicksNS();
+
+        {
+            stage_info s;
+            s.run_into(now, traces);
+
+            std::stop_source src;
+            int out = -1;
+            sleep_until_stopped(s, 100, src.get_token(), out);
+
+            src.request_stop();
+            s.run_into(now + SDL_MS_TO_NS(1), traces);
+            check(out == 0, "a sleep stopped before it's over gives false");
+        }
+
+        {
+            stage_info s;
+            s.run_into(now, traces);
+
+            std::stop_source src;
+            src.request_stop();
+
+            int out = -1;
+            sleep_until_stopped(s, 100, src.get_token(), out);
+            check(out == 0, "a sleep stopped already gives false right away");
+        }
+
+        {
+            stage_info s;
+            s.run_into(now, traces);
+
+            std::stop_source src;
+            int out = -1;
+            sleep_until_stopped(s, 10, src.get_token(), out);
+
+            // runs before the sleeper in the run that expires it, so the stop comes once the time ran out but before the sleeper resumes
+            stop_on_next_run(s, src);
+            s.run_into(now + SDL_MS_TO_NS(20), traces);
+            check(src.stop_requested(), "the stop comes in the run that expires the sleep");
+            check(out == 1, "a sleep stopped once its time ran out gives true");
+        }
+    }
+
+    inline void run()
+    {
+        run_many_ready();
+        run_stoppable_sleep();
+    }
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "coro/stage.hpp"
+#include "coro/sync/latch.hpp"
+#include "coro/sync/mutex.hpp"
+#include "coro/sync/semaphore.hpp"
+#include "check.hpp"
+
+// `async_semaphore`, `async_mutex` and `latch`: who gets a unit and when, on one thread, then from coroutines resumed on workers.
+
+namespace sync_test
+{
+    inline void run_stage(stage_info &s)
+    {
+        std::vector<trace> traces;
+        s.run_into(SDL_GetTicksNS(), traces);
+    }
+
+    // holds a unit for one run of `s`
+    inline auto take_unit(stage_info &s, async_semaphore &sem, std::vector<int> &order, int who) -> fire_and_forget
+    {
+        co_await sem.acquire();
+        order.push_back(who);
+
+        co_await s.sched();
+        sem.release();
+    }
+
+    inline void run_semaphore_fifo()
+    {
+        stage_info s;
+        async_semaphore sem{s, 1};
+        std::vector<int> order;
+
+        for (int who = 0; who < 4; ++who)
+            take_unit(s, sem, order, who);
+
+        // 0 took the unit right away, the others wait for it in line
+        check(order == std::vector<int>{0}, "a free unit is taken without suspending");
+        check(!sem.try_acquire(), "no unit is left while one is held");
+
+        for (int i = 0; i < 8; ++i)
+            run_stage(s);
+
+        check(order == std::vector<int>{0, 1, 2, 3}, "units go to the waiters in the order they came");
+        check(sem.try_acquire(), "every unit is back once the holders released them");
+    }
+
+    inline auto hold_lock(stage_info &s, async_mutex &mtx, int &inside, int &most_inside, std::size_t &done) -> fire_and_forget
+    {
+        {
+            auto lk = co_await mtx.lock();
+            auto moved = std::move(lk); // only the last guard unlocks
+
+            ++inside;
+            most_inside = std::max(most_inside, inside);
+
+            co_await s.sched(); // still held
+            --inside;
+        }
+
+        ++done;
+    }
+
+    inline void run_mutex_guard()
+    {
+        stage_info s;
+        async_mutex mtx{s};
+        int inside = 0, most_inside = 0;
+        std::size_t done = 0;
+
+        for (int i = 0; i < 5; ++i)
+            hold_lock(s, mtx, inside, most_inside, done);
+
+        check(!mtx.try_lock(), "the mutex is held across a suspension");
+
+        for (int i = 0; i < 10; ++i)
+            run_stage(s);
+
+        check(done == 5 && most_inside == 1, "one coroutine at a time holds the mutex");
+        check(mtx.try_lock(), "the guards unlock the mutex when destroyed");
+        mtx.unlock();
+    }
+
+    inline auto wait_latch(latch &l, std::size_t &woken) -> fire_and_forget
+    {
+        co_await l;
+        ++woken;
+    }
+
+    inline auto count_down_on(stage_info &s, latch &l) -> fire_and_forget
+    {
+        co_await s.sched();
+        l.count_down();
+    }
+
+    // counting down from workers, the waiters resumed on another stage
+    inline void run_latch_from_workers()
+    {
+        constexpr std::size_t n = 1000;
+
+        thread_pool pool{3};
+        stage_info work, waiters;
+        work.set_workers(&pool);
+
+        latch l{waiters, n};
+        std::size_t woken = 0;
+        for (int i = 0; i < 3; ++i)
+            wait_latch(l, woken);
+
+        for (std::size_t i{}; i < n; ++i)
+            count_down_on(work, l);
+
+        run_stage(waiters);
+        check(woken == 0 && !l.is_open(), "the latch stays closed until counted down to 0");
+
+        run_stage(work);
+        check(l.is_open(), "the latch opens once counted down to 0");
+
+        run_stage(waiters);
+        check(woken == 3, "every waiter resumes once the latch opens");
+
+        wait_latch(l, woken);
+        check(woken == 4, "an open latch doesn't suspend");
+    }
+
+    inline auto bounded(stage_info &s, async_semaphore &sem, std::atomic<std::size_t> &holders, std::size_t cap, std::atomic<std::size_t> &done) -> fire_and_forget
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            co_await sem.acquire();
+            check(holders.fetch_add(1) < cap, "no more holders than units");
+
+            co_await s.sched();
+            holders.fetch_sub(1);
+            sem.release();
+        }
+
+        done.fetch_add(1);
+    }
+
+    // acquiring and releasing from workers, the waiters resumed on the same parallel stage
+    inline void run_semaphore_from_workers()
+    {
+        constexpr std::size_t n = 1000, cap = 8;
+
+        thread_pool pool{3};
+        stage_info s;
+        s.set_workers(&pool);
+
+        async_semaphore sem{s, cap};
+        std::atomic<std::size_t> holders = 0, done = 0;
+
+        for (std::size_t i{}; i < n; ++i)
+            bounded(s, sem, holders, cap, done);
+
+        for (std::size_t i{}; i < 3 * n && done < n; ++i)
+            run_stage(s);
+
+        check(done == n, "every waiter gets a unit eventually");
+        check(holders == 0, "every unit is released");
+    }
+
+    inline void run()
+    {
+        run_semaphore_fifo();
+        run_mutex_guard();
+        run_latch_from_workers();
+        run_semaphore_from_workers();
+    }
+}